@@ -10,7 +10,9 @@ INSTALLS += actions
 testdata.path = $$CONTENTACTION_TESTDIR/data
 testdata.files = \
     highlight1.xml \
+    highlight1.hltable \
     hl-examples.xml
+testdata.CONFIG += no_check_exist
 INSTALLS += testdata
 
 XML_FILES = highlight1.xml.in
@@ -22,8 +24,15 @@ genreg.name = genreg
 genreg.CONFIG += no_link target_predeps
 QMAKE_EXTRA_COMPILERS += genreg
 
+hltable.target = highlight1.hltable
+hltable.depends = highlight1.xml $$PWD/gen-hltable
+hltable.commands = $$PWD/gen-hltable highlight1.xml highlight1.hltable
+QMAKE_EXTRA_TARGETS += hltable
+PRE_TARGETDEPS += highlight1.hltable
+QMAKE_CLEAN += highlight1.hltable
+
 highlight1.path = $$CONTENTACTION_DATADIR
-highlight1.files = highlight1.xml
+highlight1.files = highlight1.xml highlight1.hltable
 highlight1.CONFIG += no_check_exist
 INSTALLS += highlight1
 
@@ -110,7 +110,25 @@ def rx_test_setup (rx, action):
     rxt_regex = rx
     rxt_action = action
 
+# Test cases written out for the C++ tests of the generated scanners
+cppTests = []
+
+def c_string (str):
+    res = '"'
+    for b in str.encode ("utf-8"):
+        c = chr (b)
+        if c in '"\\':
+            res += '\\' + c
+        elif b < 32 or b >= 127 or c == '?':
+            res += '\\%03o' % b
+        else:
+            res += c
+    return res + '"'
+
 def rx_test (spec, delimiter = "|"):
+    if ("cpp" in sys.argv):
+        cppTests.append ((rxt_regex, rxt_action, spec, delimiter))
+        return
     if ("test" in sys.argv):
         t = SystemRegexTest (rxt_regex, rxt_action, spec, delimiter, static_counter ())
     else:
@@ -119,5 +137,11 @@ def rx_test (spec, delimiter = "|"):
 
 
 def rx_run ():
+    if ("cpp" in sys.argv):
+        print ("// Generated by data/gen-regexps cpp, do not edit.")
+        for (regex, action, spec, delimiter) in cppTests:
+            print ("{ %s, %s,\n  %s, '%s' }," % (c_string (action), c_string (regex),
+                                              c_string (spec), delimiter))
+        sys.exit (0)
     result = unittest.TextTestRunner (verbosity=1).run (regexTestSuite)
     sys.exit(not result.wasSuccessful())
@@ -9,6 +9,7 @@ Requires(post): /sbin/ldconfig
 Requires(postun): /sbin/ldconfig
 BuildRequires:  pkgconfig(glib-2.0)
 BuildRequires:  pkgconfig(mlite5)
+BuildRequires:  pkgconfig(libpcre2-16)
 BuildRequires:  pkgconfig(Qt5Core)
 BuildRequires:  pkgconfig(Qt5DBus)
 BuildRequires:  pkgconfig(Qt5Test)
@@ -68,6 +69,7 @@ This package contains the Content Action QML plugin.
 %{_bindir}/lca-tool
 %dir %{_datadir}/contentaction
 %{_datadir}/contentaction/highlight1.xml
+%{_datadir}/contentaction/highlight1.hltable
 %{_libdir}/libcontentaction5.so.*
 %{_sysconfdir}/dconf/db/vendor.d/locks/application_desktop_paths.txt
 %license COPYING
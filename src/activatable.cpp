@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "internal.h"
+
+#include <MDesktopEntry>
+
+#include <QDBusConnection>
+#include <QDBusPendingCallWatcher>
+#include <QFileInfo>
+#include <QVariantMap>
+
+#include <gio/gio.h>
+
+using namespace ContentAction::Internal;
+
+namespace ContentAction {
+
+namespace {
+
+const QString ApplicationInterface("org.freedesktop.Application");
+
+}
+
+// Desktop entries with DBusActivatable=true are launched by calling the
+// org.freedesktop.Application interface of the application, whose bus name
+// is the desktop file name without the .desktop suffix.  A running instance
+// just gets the message instead of a new process being spawned.  If the call
+// fails, the Exec line is used instead.
+ActivatablePrivate::ActivatablePrivate(QSharedPointer<MDesktopEntry> desktopEntry,
+                                       const QStringList& params)
+    : ExecPrivate(desktopEntry, params)
+{
+    QString name = QFileInfo(desktopEntry->fileName()).completeBaseName();
+    if (!name.contains('.') || name.startsWith('.') || name.endsWith('.')) {
+        LCA_WARNING << "not a valid D-Bus name for activation:" << name;
+        return;
+    }
+    busName = name;
+    // org.example.Foo-Bar -> /org/example/Foo_Bar
+    objectPath = '/' + name.replace('.', '/').replace('-', '_');
+}
+
+void ActivatablePrivate::trigger(bool wait) const
+{
+    if (busName.isEmpty()) {
+        ExecPrivate::trigger(wait);
+        return;
+    }
+
+    QDBusMessage message;
+    if (params.isEmpty()) {
+        message = QDBusMessage::createMethodCall(busName, objectPath,
+                                                 ApplicationInterface, "Activate");
+        message << QVariantMap();
+    } else {
+        message = QDBusMessage::createMethodCall(busName, objectPath,
+                                                 ApplicationInterface, "Open");
+        message << QVariant(params) << QVariantMap();
+    }
+
+    QDBusPendingCallWatcher *watcher =
+        new QDBusPendingCallWatcher(QDBusConnection::sessionBus().asyncCall(message));
+    const QString target = busName;
+    const QStringList uris = params;
+    GDesktopAppInfo *fallback =
+        appInfo ? G_DESKTOP_APP_INFO(g_object_ref(appInfo)) : 0;
+    LaunchSlotRef slot = currentLaunchSlot();
+
+    QObject::connect(watcher, &QDBusPendingCallWatcher::finished,
+                     [target, uris, fallback, slot](QDBusPendingCallWatcher *w) mutable {
+        if (w->isError()) {
+            LCA_WARNING << "cannot activate" << target << ":"
+                        << w->error().message();
+            if (fallback)
+                ExecPrivate::launch(fallback, uris);
+        }
+        if (fallback)
+            g_object_unref(fallback);
+        slot.clear();
+        w->deleteLater();
+    });
+
+    // As with plain D-Bus actions, waiting delivers finished() synchronously.
+    if (wait)
+        watcher->waitForFinished();
+}
+
+} // end namespace ContentAction
@@ -0,0 +1,470 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+#include "automaton.h"
+
+namespace ContentAction {
+namespace Internal {
+
+namespace {
+
+// {m,n} repeats copy their body, keep that from getting out of hand.
+const int MaxInstructions = 20000;
+// Lookarounds are run at every position they are reached at, so they must
+// not look far for the matching to stay linear.
+const int MaxLookaround = 64;
+
+// \w without PCRE2_UCP
+inline bool isWordChar(ushort c)
+{
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z')
+        || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+inline bool isPair(const ushort *text, int length, int pos)
+{
+    return QChar::isHighSurrogate(text[pos]) && pos + 1 < length
+        && QChar::isLowSurrogate(text[pos + 1]);
+}
+
+// Whether pos is between the two code units of a surrogate pair, where
+// PCRE never starts or ends a match in UTF mode.
+inline bool insidePair(const ushort *text, int length, int pos)
+{
+    return pos > 0 && pos < length && isPair(text, length, pos - 1);
+}
+
+// The parser turns a character outside the BMP into a group of the two
+// code units.
+bool isCharacter(const PatternNode& node, uint *code)
+{
+    if (node.type != PatternNode::Group || node.capture != 0)
+        return false;
+    const PatternNode& pair = node.children.first();
+    if (pair.type != PatternNode::Concat || pair.children.size() != 2)
+        return false;
+    const PatternNode& high = pair.children.at(0);
+    const PatternNode& low = pair.children.at(1);
+    if (high.type != PatternNode::Chars || low.type != PatternNode::Chars
+        || high.chars.size() != 1 || low.chars.size() != 1)
+        return false;
+    const ushort h = high.chars.toRanges().first().first;
+    const ushort l = low.chars.toRanges().first().first;
+    if (!QChar::isHighSurrogate(h) || !QChar::isLowSurrogate(l))
+        return false;
+    *code = QChar::surrogateToUcs4(h, l);
+    return true;
+}
+
+} // end anon namespace
+
+Automaton::Automaton()
+    : valid(false), anyStart(true)
+{
+}
+
+// The code of the patterns is the alternation of all of them, each
+// alternative starting with a Pattern instruction which tells the threads
+// which pattern they are in.
+Automaton::Automaton(const QStringList& patterns)
+    : valid(true), anyStart(true)
+{
+    QList<int> jumps;
+    for (int i = 0; i < patterns.size() && valid; ++i) {
+        PatternNode root;
+        if (!parsePattern(patterns[i], &root)) {
+            valid = false;
+            break;
+        }
+        int split = -1;
+        if (i + 1 < patterns.size()) {
+            split = emit(Instruction::Split);
+            code[split].next = split + 1;
+        }
+        int pattern = emit(Instruction::Pattern);
+        code[pattern].code = i;
+        code[pattern].next = pattern + 1;
+        valid = compile(root);
+        jumps << emit(Instruction::Jump);
+        if (split != -1)
+            code[split].alt = code.size();
+    }
+    const int match = emit(Instruction::Match);
+    Q_FOREACH (int jump, jumps)
+        code[jump].next = match;
+    if (valid)
+        computeFirstChars();
+    else
+        code.clear();
+}
+
+bool Automaton::supports(const QString& pattern)
+{
+    return Automaton(QStringList() << pattern).isValid();
+}
+
+bool Automaton::isValid() const
+{
+    return valid;
+}
+
+int Automaton::emit(Instruction::Op op)
+{
+    Instruction instruction;
+    instruction.op = op;
+    instruction.next = code.size() + 1;
+    code << instruction;
+    return code.size() - 1;
+}
+
+// Appends the code of node, which continues at the instruction after it.
+bool Automaton::compile(const PatternNode& node)
+{
+    if (code.size() > MaxInstructions)
+        return false;
+
+    uint character;
+    switch (node.type) {
+    case PatternNode::Empty:
+        return true;
+    case PatternNode::Chars: {
+        int pc = emit(Instruction::Chars);
+        code[pc].chars = node.chars;
+        return true;
+    }
+    case PatternNode::Concat:
+        Q_FOREACH (const PatternNode& child, node.children) {
+            if (!compile(child))
+                return false;
+        }
+        return true;
+    case PatternNode::Alternation: {
+        QList<int> jumps;
+        for (int i = 0; i < node.children.size(); ++i) {
+            int split = -1;
+            if (i + 1 < node.children.size())
+                split = emit(Instruction::Split);
+            if (!compile(node.children[i]))
+                return false;
+            if (split != -1) {
+                jumps << emit(Instruction::Jump);
+                code[split].alt = code.size();
+            }
+        }
+        Q_FOREACH (int jump, jumps)
+            code[jump].next = code.size();
+        return true;
+    }
+    case PatternNode::Group:
+        if (isCharacter(node, &character)) {
+            int pc = emit(Instruction::Character);
+            code[pc].code = character;
+            return true;
+        }
+        return compile(node.children.first());
+    case PatternNode::Repeat: {
+        const PatternNode& body = node.children.first();
+        for (int i = 0; i < node.min; ++i) {
+            if (!compile(body))
+                return false;
+        }
+        if (node.max == -1) {
+            // L: split body, end; body; jump L
+            int split = emit(Instruction::Split);
+            if (!compile(body))
+                return false;
+            int jump = emit(Instruction::Jump);
+            code[jump].next = split;
+            code[split].alt = code.size();
+            if (!node.greedy)
+                qSwap(code[split].next, code[split].alt);
+            return true;
+        }
+        // body{0,n} is (body(body(...)?)?)?, and any of the optional
+        // parts skips to the end
+        QList<int> splits;
+        for (int i = node.min; i < node.max; ++i) {
+            splits << emit(Instruction::Split);
+            if (!compile(body))
+                return false;
+        }
+        Q_FOREACH (int split, splits) {
+            code[split].alt = code.size();
+            if (!node.greedy)
+                qSwap(code[split].next, code[split].alt);
+        }
+        return true;
+    }
+    case PatternNode::LookAhead:
+    case PatternNode::NegLookAhead:
+    case PatternNode::LookBehind:
+    case PatternNode::NegLookBehind: {
+        // The code of the lookaround follows the assertion, which jumps
+        // over it.
+        const PatternNode& body = node.children.first();
+        const int longest = maximumLength(body);
+        if (longest == -1 || longest > MaxLookaround)
+            return false;
+        int pc = emit(Instruction::Assert);
+        code[pc].assertion = node.type;
+        // a character may be two code units
+        code[pc].lookbehind = 2 * longest;
+        if (!compile(body))
+            return false;
+        emit(Instruction::Match);
+        code[pc].alt = code.size();
+        code[pc].next = code.size();
+        return true;
+    }
+    case PatternNode::WordBoundary:
+    case PatternNode::NotWordBoundary:
+    case PatternNode::Start:
+    case PatternNode::End: {
+        int pc = emit(Instruction::Assert);
+        code[pc].assertion = node.type;
+        return true;
+    }
+    }
+    return false;
+}
+
+// Collects the code units the first instructions which consume something
+// accept, so that the search can skip over the text no match starts in.
+void Automaton::computeFirstChars()
+{
+    anyStart = false;
+    QVector<bool> seen(code.size(), false);
+    QVector<int> stack;
+    stack << 0;
+    while (!stack.isEmpty()) {
+        int pc = stack.last();
+        stack.removeLast();
+        if (seen[pc])
+            continue;
+        seen[pc] = true;
+        const Instruction& instruction = code[pc];
+        switch (instruction.op) {
+        case Instruction::Chars:
+            firstChars.add(instruction.chars);
+            break;
+        case Instruction::Character:
+            firstChars.add(QChar::highSurrogate(instruction.code));
+            break;
+        case Instruction::Split:
+            stack << instruction.alt << instruction.next;
+            break;
+        case Instruction::Assert:
+            // the lookarounds don't consume anything, the code after them
+            // does
+        case Instruction::Jump:
+        case Instruction::Pattern:
+            stack << instruction.next;
+            break;
+        case Instruction::Match:
+            anyStart = true;
+            return;
+        }
+    }
+}
+
+// Adds the threads which continue from pc at pos to list, in the order of
+// their priority, following the instructions which don't consume anything.
+// Each instruction gets only one thread at a position, the one with the
+// highest priority.
+void Automaton::addThread(Run *r, QVector<Thread> *list, int pc, int pos, int start,
+                          int pattern) const
+{
+    const int stamp = pos + 1;
+    Thread thread = { pc, start, pattern };
+    r->stack << thread;
+    while (!r->stack.isEmpty()) {
+        Thread t = r->stack.last();
+        r->stack.removeLast();
+        int& mark = r->marks[t.pc - r->first];
+        if (mark == stamp)
+            continue;
+        mark = stamp;
+        const Instruction& instruction = code[t.pc];
+        switch (instruction.op) {
+        case Instruction::Split: {
+            Thread alt = { instruction.alt, t.start, t.pattern };
+            Thread next = { instruction.next, t.start, t.pattern };
+            r->stack << alt << next;
+            break;
+        }
+        case Instruction::Jump:
+            t.pc = instruction.next;
+            r->stack << t;
+            break;
+        case Instruction::Pattern:
+            t.pc = instruction.next;
+            t.pattern = instruction.code;
+            r->stack << t;
+            break;
+        case Instruction::Assert:
+            if (assertionHolds(instruction, t.pc, r->text, r->length, pos)) {
+                t.pc = instruction.next;
+                r->stack << t;
+            }
+            break;
+        default:
+            *list << t;
+            break;
+        }
+    }
+}
+
+bool Automaton::assertionHolds(const Instruction& instruction, int pc,
+                               const ushort *text, int length, int pos) const
+{
+    switch (instruction.assertion) {
+    case PatternNode::WordBoundary:
+    case PatternNode::NotWordBoundary: {
+        bool before = pos > 0 && isWordChar(text[pos - 1]);
+        bool after = pos < length && isWordChar(text[pos]);
+        return (before != after) == (instruction.assertion == PatternNode::WordBoundary);
+    }
+    case PatternNode::Start:
+        return pos == 0;
+    case PatternNode::End:
+        // before a newline at the end, too
+        return pos == length || (pos == length - 1 && text[pos] == '\n');
+    case PatternNode::LookAhead:
+    case PatternNode::NegLookAhead: {
+        bool found = matchesAt(pc + 1, instruction.alt, text, length, pos, -1);
+        return found == (instruction.assertion == PatternNode::LookAhead);
+    }
+    case PatternNode::LookBehind:
+    case PatternNode::NegLookBehind: {
+        bool found = false;
+        for (int back = 0; back <= instruction.lookbehind && back <= pos && !found; ++back) {
+            if (!insidePair(text, length, pos - back))
+                found = matchesAt(pc + 1, instruction.alt, text, length, pos - back, pos);
+        }
+        return found == (instruction.assertion == PatternNode::LookBehind);
+    }
+    default:
+        return true;
+    }
+}
+
+// Runs the code of a lookaround, in [first, last), anchored at pos.  Any
+// match will do, or if end is not -1, any match which ends there.
+bool Automaton::matchesAt(int first, int last, const ushort *text, int length, int pos,
+                          int end) const
+{
+    Run r;
+    r.text = text;
+    r.length = length;
+    r.first = first;
+    r.marks.fill(0, last - first);
+    QVector<Thread> current, following;
+    addThread(&r, &current, first, pos, pos, -1);
+    while (!current.isEmpty()) {
+        const bool atEnd = pos >= length || (end != -1 && pos >= end);
+        const int width = atEnd ? 0 : (isPair(text, length, pos) ? 2 : 1);
+        following.clear();
+        Q_FOREACH (const Thread& t, current) {
+            const Instruction& instruction = code[t.pc];
+            if (instruction.op == Instruction::Match) {
+                if (end == -1 || pos == end)
+                    return true;
+            } else if (!atEnd) {
+                bool accepted = instruction.op == Instruction::Chars
+                    ? instruction.chars.contains(text[pos])
+                    : width == 2 && QChar::surrogateToUcs4(text[pos], text[pos + 1]) == instruction.code;
+                if (accepted)
+                    addThread(&r, &following, t.pc + 1, pos + width, t.start, t.pattern);
+            }
+        }
+        if (atEnd)
+            break;
+        pos += width;
+        qSwap(current, following);
+    }
+    return false;
+}
+
+// The leftmost match, and of the matches starting there the one PCRE
+// prefers.  The threads started at earlier positions have priority over the
+// later ones, and once a thread matches, the threads after it are dropped.
+int Automaton::search(const ushort *text, int length, int pos,
+                      int *matchStart, int *matchEnd) const
+{
+    Run r;
+    r.text = text;
+    r.length = length;
+    r.first = 0;
+    r.marks.fill(0, code.size());
+    QVector<Thread> current, following;
+    int matched = -1;
+    if (insidePair(text, length, pos))
+        ++pos;
+    while (true) {
+        if (matched == -1) {
+            if (current.isEmpty() && !anyStart) {
+                while (pos < length && (!firstChars.contains(text[pos])
+                                        || insidePair(text, length, pos)))
+                    ++pos;
+                if (pos == length)
+                    break;
+            }
+            addThread(&r, &current, 0, pos, pos, -1);
+        }
+        if (current.isEmpty())
+            break;
+        const bool atEnd = pos >= length;
+        const int width = atEnd ? 0 : (isPair(text, length, pos) ? 2 : 1);
+        following.clear();
+        Q_FOREACH (const Thread& t, current) {
+            const Instruction& instruction = code[t.pc];
+            if (instruction.op == Instruction::Match) {
+                matched = t.pattern;
+                *matchStart = t.start;
+                *matchEnd = pos;
+                break;
+            }
+            if (atEnd)
+                continue;
+            bool accepted = instruction.op == Instruction::Chars
+                ? instruction.chars.contains(text[pos])
+                : width == 2 && QChar::surrogateToUcs4(text[pos], text[pos + 1]) == instruction.code;
+            if (accepted)
+                addThread(&r, &following, t.pc + 1, pos + width, t.start, t.pattern);
+        }
+        if (atEnd)
+            break;
+        pos += width;
+        qSwap(current, following);
+    }
+    return matched;
+}
+
+int Automaton::next(const QString& text, int start, int *matchStart, int *matchLength) const
+{
+    if (!valid || start > text.length())
+        return -1;
+    int end;
+    int found = search(text.utf16(), text.length(), start, matchStart, &end);
+    if (found != -1)
+        *matchLength = end - *matchStart;
+    return found;
+}
+
+} // end namespace Internal
+} // end namespace ContentAction
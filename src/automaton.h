@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef AUTOMATON_H
+#define AUTOMATON_H
+
+#include "pattern.h"
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+namespace ContentAction {
+namespace Internal {
+
+// Matches a list of regexps as the alternatives of one regexp, without
+// backtracking: all the ways the regexps can match are followed at once, in
+// the order PCRE would try them (a Pike VM, like RE2 uses).  A search starts
+// a thread at each position as it goes, instead of trying the regexps again
+// from each position, so the time taken is linear in the length of the text
+// it looks at, times the size of the regexps.  That is past the end of the
+// match it finds only as long as a preferred way to match is still alive,
+// like the a+b of a+b|a in a long run of a's.
+//
+// Regexps which parsePattern() does not understand, and lookarounds which
+// can look arbitrarily far, are not supported.
+class LCA_EXPORT Automaton
+{
+public:
+    Automaton();
+    // Compiles \a patterns, which must all be supported.
+    explicit Automaton(const QStringList& patterns);
+
+    static bool supports(const QString& pattern);
+
+    bool isValid() const;
+    // Finds the first match at or after \a start, like the master regexp of
+    // a HighlightScanner.  Returns the index of the matching pattern and
+    // sets \a matchStart and \a matchLength, or returns -1.
+    int next(const QString& text, int start, int *matchStart, int *matchLength) const;
+
+private:
+    struct Instruction
+    {
+        enum Op {
+            Chars,      // one character out of chars
+            Character,  // the character outside the BMP in code
+            Split,      // continue at next and at alt, next preferred
+            Jump,       // continue at next
+            Pattern,    // the thread is in the pattern number code
+            Assert,     // continue at next if assertion holds
+            Match
+        };
+
+        Instruction() : op(Match), next(-1), alt(-1), code(0),
+                        assertion(PatternNode::Empty), lookbehind(0) {}
+
+        Op op;
+        int next;
+        int alt;
+        uint code;
+        CharSet chars;
+        PatternNode::Type assertion;
+        // for lookbehinds, the most code units they look back
+        int lookbehind;
+    };
+
+    struct Thread
+    {
+        int pc;
+        int start;
+        int pattern;
+    };
+
+    // What a run of the code in [first, last) needs for following threads
+    struct Run
+    {
+        const ushort *text;
+        int length;
+        int first;
+        // the position + 1 each instruction was last visited at
+        QVector<int> marks;
+        QVector<Thread> stack;
+    };
+
+    bool compile(const PatternNode& node);
+    int emit(Instruction::Op op);
+    void computeFirstChars();
+    void addThread(Run *r, QVector<Thread> *list, int pc, int pos, int start,
+                   int pattern) const;
+    bool assertionHolds(const Instruction& instruction, int pc, const ushort *text,
+                        int length, int pos) const;
+    int search(const ushort *text, int length, int pos, int *matchStart, int *matchEnd) const;
+    bool matchesAt(int first, int last, const ushort *text, int length, int pos,
+                   int end) const;
+
+    QVector<Instruction> code;
+    bool valid;
+    // the code units a match can start with, unless anyStart
+    CharSet firstChars;
+    bool anyStart;
+};
+
+} // end namespace Internal
+} // end namespace ContentAction
+
+#endif
@@ -0,0 +1,387 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+#include "backends.h"
+#include "internal.h"
+
+#include <QRegularExpression>
+#include <QVarLengthArray>
+
+namespace ContentAction {
+namespace Internal {
+
+namespace {
+
+// The work PCRE may do for a text: enough for any sane regexp, but a
+// regexp which backtracks catastrophically gives up in milliseconds instead
+// of taking seconds.  The limit grows with the text a search runs over, up
+// to a cap, so that a long text does not allow unbounded work.
+const quint32 MatchLimit = 100000;
+const quint32 MatchLimitPerChar = 1000;
+const quint32 MaxMatchLimit = 10000000;
+const quint32 DepthLimit = 10000;
+
+// Whether pos is inside a surrogate pair, where no match starts
+bool insideCharacter(const ushort *text, int length, int pos)
+{
+    return pos > 0 && pos < length && QChar::isLowSurrogate(text[pos])
+        && QChar::isHighSurrogate(text[pos - 1]);
+}
+
+// Whether pos is at a continuation byte of a UTF-8 sequence
+bool insideCharacter(const uchar *text, int length, int pos)
+{
+    return pos > 0 && pos < length && (text[pos] & 0xc0) == 0x80;
+}
+
+// A run of a scanner from a start position: the state it has reached, and
+// the match it would give if it stopped matching there.
+struct ScannerRun
+{
+    int scanner;
+    int start;
+    quint32 state;
+    int matchStart;
+    int matchEnd;
+};
+
+// Whether a match of scanner at start would win over the best one so far
+bool precedes(int start, int scanner, int bestStart, int best)
+{
+    return start < bestStart || (start == bestStart && scanner < best);
+}
+
+// The leftmost match, and of the ones starting there the one of the first
+// scanner, like the alternatives of a regexp.  The scanners are run from all
+// the positions in one pass over the text.  Runs of a scanner which reach the
+// same state at the same position find the same matches from there on, so
+// only the one which started first goes on, keeping the match of the other
+// if it has none.  So there are never more runs than states, and a text is
+// looked at once however long the partial matches in it are.
+template <typename Char>
+int firstMatch(const QList<const GeneratedScanner *>& scanners, const Char *text,
+               int length, int start, int *matchStart, int *matchLength)
+{
+    const int count = scanners.size();
+    const int other = ScannerClassCount - 1;
+    // where the states of each scanner begin in reachedAt and reachedBy
+    QVarLengthArray<int, 8> offsets(count);
+    int states = 0;
+    for (int i = 0; i < count; ++i) {
+        offsets[i] = states;
+        states += scanners[i]->states;
+    }
+    // the last position at which each state was reached, and by which run
+    QVarLengthArray<int, 1024> reachedAt(states), reachedBy(states);
+    for (int i = 0; i < states; ++i)
+        reachedAt[i] = -1;
+
+    QVarLengthArray<ScannerRun, 64> lists[2];
+    int current = 0;
+    int best = -1, bestStart = length + 1, bestEnd = -1;
+    for (int pos = start;; ++pos) {
+        QVarLengthArray<ScannerRun, 64>& runs = lists[current];
+        if (!insideCharacter(text, length, pos)) {
+            for (int i = 0; i < count && precedes(pos, i, bestStart, best); ++i) {
+                const ScannerRun run = { i, pos, 1, -1, -1 };
+                runs.append(run);
+            }
+        }
+        if (runs.isEmpty() && (best != -1 || pos >= length))
+            break;
+
+        QVarLengthArray<ScannerRun, 64>& following = lists[1 - current];
+        following.clear();
+        const int c = pos < length ? text[pos] : 0;
+        const int cls = c < 128 ? ScannerClasses[c] : other;
+        for (int r = 0; r < runs.size(); ++r) {
+            ScannerRun run = runs[r];
+            const GeneratedScanner *scanner = scanners[run.scanner];
+            if (!precedes(run.start, run.scanner, bestStart, best))
+                continue;
+            if (pos == length) {
+                if (scanner->accepts[run.state]) {
+                    run.matchStart = run.start;
+                    run.matchEnd = length;
+                }
+                run.state = 0;
+            } else {
+                const quint32 next =
+                    scanner->transitions[run.state * ScannerClassCount + cls];
+                if (next & 1) {
+                    run.matchStart = run.start;
+                    run.matchEnd = pos;
+                }
+                run.state = next >> 1;
+            }
+            if (run.state == 0) {
+                if (run.matchStart != -1
+                    && precedes(run.matchStart, run.scanner, bestStart, best)) {
+                    best = run.scanner;
+                    bestStart = run.matchStart;
+                    bestEnd = run.matchEnd;
+                }
+                continue;
+            }
+            // The runs are in the order they started, so a run which reached
+            // the state first started earlier.
+            const int reached = offsets[run.scanner] + run.state;
+            if (reachedAt[reached] == pos) {
+                ScannerRun& first = following[reachedBy[reached]];
+                if (run.matchStart != -1
+                    && (first.matchStart == -1 || run.matchStart < first.matchStart)) {
+                    first.matchStart = run.matchStart;
+                    first.matchEnd = run.matchEnd;
+                }
+            } else {
+                reachedAt[reached] = pos;
+                reachedBy[reached] = following.size();
+                following.append(run);
+            }
+        }
+        runs.clear();
+        current = 1 - current;
+        if (pos == length)
+            break;
+    }
+
+    if (best != -1) {
+        *matchStart = bestStart;
+        *matchLength = bestEnd - bestStart;
+    }
+    return best;
+}
+
+QStringList scannerPatterns(const QList<const GeneratedScanner *>& scanners)
+{
+    QStringList patterns;
+    Q_FOREACH (const GeneratedScanner *scanner, scanners)
+        patterns << QString::fromUtf8(scanner->pattern);
+    return patterns;
+}
+
+// The backend of previous which matches patterns with engine, for
+// categories, or null if there is none.
+QSharedPointer<const HighlightBackend>
+reuse(const QList<QSharedPointer<const HighlightBackend> >& previous, HighlightEngine engine,
+      const QStringList& patterns, const QList<int>& categories)
+{
+    Q_FOREACH (const QSharedPointer<const HighlightBackend>& backend, previous) {
+        if (backend->engine() != engine || backend->patterns() != patterns)
+            continue;
+        if (backend->categories() == categories)
+            return backend;
+        return QSharedPointer<const HighlightBackend>(backend->reindexed(categories));
+    }
+    return QSharedPointer<const HighlightBackend>();
+}
+
+} // end anon namespace
+
+HighlightBackend::HighlightBackend(const QList<int>& categories, const QStringList& patterns)
+    : cats(categories), pats(patterns)
+{
+}
+
+HighlightBackend::~HighlightBackend()
+{
+}
+
+const QList<int>& HighlightBackend::categories() const
+{
+    return cats;
+}
+
+const QStringList& HighlightBackend::patterns() const
+{
+    return pats;
+}
+
+HighlightBackend *HighlightBackend::reindexed(const QList<int>& categories) const
+{
+    HighlightBackend *backend = clone();
+    backend->cats = categories;
+    return backend;
+}
+
+GeneratedBackend::GeneratedBackend(const QList<int>& categories,
+                                   const QList<const GeneratedScanner *>& scanners)
+    : HighlightBackend(categories, scannerPatterns(scanners)), scanners(scanners)
+{
+}
+
+HighlightBackend *GeneratedBackend::clone() const
+{
+    return new GeneratedBackend(*this);
+}
+
+HighlightEngine GeneratedBackend::engine() const
+{
+    return GeneratedEngine;
+}
+
+int GeneratedBackend::next(const QString& text, int start,
+                           int *matchStart, int *matchLength) const
+{
+    return firstMatch(scanners, text.utf16(), text.length(), start,
+                      matchStart, matchLength);
+}
+
+int GeneratedBackend::next(const uchar *text, int length, int start,
+                           int *matchStart, int *matchLength) const
+{
+    return firstMatch(scanners, text, length, start, matchStart, matchLength);
+}
+
+AutomatonBackend::AutomatonBackend(const QList<int>& categories, const QStringList& patterns)
+    : HighlightBackend(categories, patterns), automaton(new Automaton(patterns))
+{
+}
+
+HighlightBackend *AutomatonBackend::clone() const
+{
+    return new AutomatonBackend(*this);
+}
+
+HighlightEngine AutomatonBackend::engine() const
+{
+    return AutomatonEngine;
+}
+
+int AutomatonBackend::next(const QString& text, int start,
+                           int *matchStart, int *matchLength) const
+{
+    return automaton->next(text, start, matchStart, matchLength);
+}
+
+BacktrackingBackend::BacktrackingBackend(const QList<int>& categories,
+                                         const QStringList& patterns,
+                                         CompiledRegexp::CacheMode mode)
+    : HighlightBackend(categories, patterns)
+{
+    QString re("(?:");
+    int group = 1;
+    Q_FOREACH (const QString& pattern, patterns) {
+        if (group > 1)
+            re += '|';
+        re += '(' + pattern + ')';
+        groups << group;
+        // the wrapping group and the groups of the pattern itself
+        group += 1 + QRegularExpression(pattern).captureCount();
+    }
+    re += ")";
+    regexp = QSharedPointer<CompiledRegexp>(new CompiledRegexp(re, QString(), mode));
+    if (regexp->isValid())
+        regexp->setLimits(MatchLimit, MatchLimitPerChar, MaxMatchLimit, DepthLimit);
+    else
+        regexp.clear();
+}
+
+bool BacktrackingBackend::isValid() const
+{
+    return !regexp.isNull();
+}
+
+HighlightBackend *BacktrackingBackend::clone() const
+{
+    return new BacktrackingBackend(*this);
+}
+
+HighlightEngine BacktrackingBackend::engine() const
+{
+    return BacktrackingEngine;
+}
+
+int BacktrackingBackend::next(const QString& text, int start,
+                              int *matchStart, int *matchLength) const
+{
+    if (!regexp)
+        return -1;
+    QVector<int> captures;
+    CompiledRegexp::Failure failure;
+    if (!regexp->match(text, start, &captures, &failure)) {
+        if (failure == CompiledRegexp::LimitReached)
+            LCA_WARNING << "highlighting gave up on a text after too much backtracking";
+        else if (failure == CompiledRegexp::StackExhausted)
+            LCA_WARNING << "highlighting gave up on a text which needs too much JIT stack";
+        else if (failure == CompiledRegexp::MatchError)
+            LCA_WARNING << "highlighting failed on a text";
+        return -1;
+    }
+    *matchStart = captures[0];
+    *matchLength = captures[1] - captures[0];
+    for (int i = 0; i < groups.size(); ++i) {
+        if (captures[2 * groups[i]] != -1)
+            return i;
+    }
+    return -1;
+}
+
+QList<QSharedPointer<const HighlightBackend> >
+createBackends(const QStringList& patterns,
+               const QList<QSharedPointer<const HighlightBackend> >& previous,
+               CompiledRegexp::CacheMode mode)
+{
+    QList<int> generated, automaton, backtracking;
+    QList<const GeneratedScanner *> scanners;
+    QStringList automatonPatterns, backtrackingPatterns;
+    for (int i = 0; i < patterns.size(); ++i) {
+        if (const GeneratedScanner *scanner = generatedScanner(patterns[i])) {
+            generated << i;
+            scanners << scanner;
+        } else if (Automaton::supports(patterns[i])) {
+            automaton << i;
+            automatonPatterns << patterns[i];
+        } else {
+            backtracking << i;
+            backtrackingPatterns << patterns[i];
+        }
+    }
+
+    QList<QSharedPointer<const HighlightBackend> > backends;
+    if (!generated.isEmpty())
+        backends << QSharedPointer<const HighlightBackend>(
+            new GeneratedBackend(generated, scanners));
+    if (!automaton.isEmpty()) {
+        QSharedPointer<const HighlightBackend> backend =
+            reuse(previous, AutomatonEngine, automatonPatterns, automaton);
+        if (!backend)
+            backend = QSharedPointer<const HighlightBackend>(
+                new AutomatonBackend(automaton, automatonPatterns));
+        backends << backend;
+    }
+    if (!backtracking.isEmpty()) {
+        QSharedPointer<const HighlightBackend> backend =
+            reuse(previous, BacktrackingEngine, backtrackingPatterns, backtracking);
+        if (!backend) {
+            BacktrackingBackend *compiled = new BacktrackingBackend(backtracking,
+                                                                    backtrackingPatterns,
+                                                                    mode);
+            if (compiled->isValid())
+                backend = QSharedPointer<const HighlightBackend>(compiled);
+            else
+                delete compiled;
+        }
+        if (backend)
+            backends << backend;
+    }
+    return backends;
+}
+
+} // end namespace Internal
+} // end namespace ContentAction
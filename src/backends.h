@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef BACKENDS_H
+#define BACKENDS_H
+
+#include "contentaction.h"
+#include "automaton.h"
+#include "regexpcache.h"
+#include "scanners.h"
+
+#include <QList>
+#include <QSharedPointer>
+#include <QString>
+#include <QStringList>
+
+namespace ContentAction {
+namespace Internal {
+
+// Matches some of the categories of a HighlightScanner with one engine.
+class LCA_EXPORT HighlightBackend
+{
+public:
+    HighlightBackend(const QList<int>& categories, const QStringList& patterns);
+    virtual ~HighlightBackend();
+
+    virtual HighlightEngine engine() const = 0;
+    // Like HighlightScanner::next(), but returns an index into categories().
+    virtual int next(const QString& text, int start,
+                     int *matchStart, int *matchLength) const = 0;
+
+    // the indexes of the scanner's categories this backend matches, in
+    // order
+    const QList<int>& categories() const;
+    // the regexps of the categories
+    const QStringList& patterns() const;
+    // A backend which matches the same patterns for other categories,
+    // sharing the compiled matcher with this one
+    HighlightBackend *reindexed(const QList<int>& categories) const;
+
+protected:
+    virtual HighlightBackend *clone() const = 0;
+
+private:
+    QList<int> cats;
+    QStringList pats;
+};
+
+class LCA_EXPORT GeneratedBackend : public HighlightBackend
+{
+public:
+    GeneratedBackend(const QList<int>& categories,
+                     const QList<const GeneratedScanner *>& scanners);
+    HighlightEngine engine() const;
+    int next(const QString& text, int start, int *matchStart, int *matchLength) const;
+    // The same for UTF-8 text, with byte offsets.
+    int next(const uchar *text, int length, int start,
+             int *matchStart, int *matchLength) const;
+
+protected:
+    HighlightBackend *clone() const;
+
+private:
+    QList<const GeneratedScanner *> scanners;
+};
+
+class LCA_EXPORT AutomatonBackend : public HighlightBackend
+{
+public:
+    AutomatonBackend(const QList<int>& categories, const QStringList& patterns);
+    HighlightEngine engine() const;
+    int next(const QString& text, int start, int *matchStart, int *matchLength) const;
+
+protected:
+    HighlightBackend *clone() const;
+
+private:
+    QSharedPointer<const Automaton> automaton;
+};
+
+// The categories are the alternatives of one regexp, like the master regexp
+// of the scanner, compiled with PCRE2.  The matching gives up on texts which
+// make it backtrack too much.  The compiled regexp is kept in the disk cache
+// if \a mode says so.
+class LCA_EXPORT BacktrackingBackend : public HighlightBackend
+{
+public:
+    BacktrackingBackend(const QList<int>& categories, const QStringList& patterns,
+                        CompiledRegexp::CacheMode mode = CompiledRegexp::UseCache);
+    bool isValid() const;
+    HighlightEngine engine() const;
+    int next(const QString& text, int start, int *matchStart, int *matchLength) const;
+
+protected:
+    HighlightBackend *clone() const;
+
+private:
+    QSharedPointer<CompiledRegexp> regexp;
+    // capture group of each alternative
+    QList<int> groups;
+};
+
+// Matches each of patterns with the fastest engine which supports it: the
+// generated scanners, then the automaton, then PCRE.  A backend of previous
+// which has the same patterns for the same engine is reused instead of
+// compiling them again.  Regexps compiled with PCRE are stored in the disk
+// cache only if \a mode says so.
+LCA_EXPORT QList<QSharedPointer<const HighlightBackend> >
+createBackends(const QStringList& patterns,
+               const QList<QSharedPointer<const HighlightBackend> >& previous =
+                   QList<QSharedPointer<const HighlightBackend> >(),
+               CompiledRegexp::CacheMode mode = CompiledRegexp::UseCache);
+
+} // end namespace Internal
+} // end namespace ContentAction
+
+#endif
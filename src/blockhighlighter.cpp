@@ -0,0 +1,283 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+#include "contentaction.h"
+#include "internal.h"
+#include "highlight.h"
+
+#include <QVector>
+
+#include <algorithm>
+
+namespace ContentAction {
+
+using namespace ContentAction::Internal;
+
+namespace {
+
+struct Block
+{
+    Block() : length(0), carryIn(0) {}
+
+    int length; // without the terminating newline
+    // where scanning starts in the block; nonzero if a match from the
+    // previous block continues into this one
+    int carryIn;
+    // (start, length) of the matches starting in the block, relative to it
+    QList<QPair<int, int> > matches;
+};
+
+} // end anon namespace
+
+struct BlockHighlighter::Private
+{
+    Private() : rescanned(0) {}
+
+    int blockAt(int position) const;
+    void split(const QString& segment, QList<Block>& result) const;
+    void layout();
+    int scan(int block);
+    void rescan(int first, int last);
+
+    QString text;
+    QList<Block> blocks;
+    // start position of each block in text
+    QVector<int> starts;
+    int rescanned;
+    // the scanner the matches were found with
+    QSharedPointer<const HighlightScanner> scanner;
+};
+
+// Returns the block which contains \a position.
+int BlockHighlighter::Private::blockAt(int position) const
+{
+    QVector<int>::const_iterator it =
+        std::upper_bound(starts.constBegin(), starts.constEnd(), position);
+    return qMax(0, int(it - starts.constBegin()) - 1);
+}
+
+void BlockHighlighter::Private::split(const QString& segment, QList<Block>& result) const
+{
+    int from = 0;
+    while (true) {
+        int nl = segment.indexOf('\n', from);
+        Block block;
+        block.length = (nl == -1 ? segment.length() : nl) - from;
+        result << block;
+        if (nl == -1)
+            break;
+        from = nl + 1;
+    }
+}
+
+void BlockHighlighter::Private::layout()
+{
+    starts.resize(blocks.size());
+    int pos = 0;
+    for (int i = 0; i < blocks.size(); ++i) {
+        starts[i] = pos;
+        pos += blocks[i].length + 1;
+    }
+}
+
+// Finds the matches starting in \a block.  The scan sees the previous block
+// and the next one as context, so a match may continue over one line break.
+// Returns where scanning should start in the next block.
+int BlockHighlighter::Private::scan(int block)
+{
+    Block& b = blocks[block];
+    const int start = starts[block];
+    const int end = start + b.length;
+    const int contextStart = block > 0 ? starts[block - 1] : 0;
+    const int contextEnd = block + 1 < blocks.size()
+        ? starts[block + 1] + blocks[block + 1].length : end;
+    const QString window = text.mid(contextStart, contextEnd - contextStart);
+
+    b.matches.clear();
+    int pos = start + b.carryIn - contextStart;
+    int resume = start + b.carryIn;
+    int matchStart, matchLength;
+    while (scanner->next(window, pos, &matchStart, &matchLength) != -1) {
+        matchStart += contextStart;
+        if (matchStart > end)
+            break;
+        b.matches << qMakePair(matchStart - start, matchLength);
+        resume = matchStart + matchLength;
+        pos = resume - contextStart;
+        if (matchLength == 0)
+            // regexp matched an empty string, avoid the inifinite loop
+            ++pos;
+    }
+    return qMax(0, resume - (end + 1));
+}
+
+// Scans the blocks from \a first on.  The blocks up to the one after \a last
+// are always scanned, the ones after that only as long as the state carried
+// into them changes.  If the highlighter configuration has been reloaded
+// since the last scan, or its categories have priorities, all the blocks are
+// scanned again.
+void BlockHighlighter::Private::rescan(int first, int last)
+{
+    rescanned = 0;
+    const QSharedPointer<const HighlightScanner> current = highlightScanner();
+    if (current != scanner) {
+        scanner = current;
+        first = 0;
+        last = blocks.size() - 1;
+    }
+    if (scanner->isEmpty()) {
+        for (int i = first; i < blocks.size(); ++i) {
+            blocks[i].carryIn = 0;
+            blocks[i].matches.clear();
+        }
+        return;
+    }
+
+    if (scanner->hasPriorities()) {
+        // A match of a higher priority anywhere may push out a match which
+        // in turn kept out others, so the whole text is scanned again.
+        for (int i = 0; i < blocks.size(); ++i) {
+            blocks[i].carryIn = 0;
+            blocks[i].matches.clear();
+        }
+        Q_FOREACH (const Highlight& h, selectHighlights(*scanner, text)) {
+            const int block = blockAt(h.start);
+            blocks[block].matches << qMakePair(h.start - starts[block], h.length);
+        }
+        rescanned = blocks.size();
+        return;
+    }
+
+    int carry = first > 0 ? blocks[first].carryIn : 0;
+    for (int i = first; i < blocks.size(); ++i) {
+        if (i > last + 1 && blocks[i].carryIn == carry)
+            break;
+        blocks[i].carryIn = carry;
+        carry = scan(i);
+        ++rescanned;
+    }
+}
+
+/// \class ContentAction::BlockHighlighter
+/// Keeps the highlights of a text which is being edited, like in a text
+/// field.  The text is split into blocks at line breaks, and the matches of
+/// each block are kept.  An edit rescans only the edited blocks and their
+/// neighbours, plus the following blocks as long as a match continues from
+/// one block to the next, so the length of the text the regexps run over
+/// does not depend on the length of the whole text.  Updating the text and
+/// the positions of the blocks still takes time linear in the length of the
+/// text and in the number of blocks, but that is only copying and adding
+/// up.  Matches can continue over a single line break.  The blocks are the
+/// same as the blocks of a QTextDocument, so the matches of a block can be
+/// used directly in QSyntaxHighlighter::highlightBlock().  If the
+/// highlighter configuration is reloaded, the next edit rescans all the
+/// blocks.  If the highlighter categories have priorities, the matches are
+/// selected like in Action::findHighlights(), and as an edit can then change
+/// the matches far from it, every edit rescans the whole text.
+
+BlockHighlighter::BlockHighlighter()
+    : priv(new Private)
+{
+    setText(QString());
+}
+
+BlockHighlighter::~BlockHighlighter()
+{
+    delete priv;
+}
+
+/// Replaces the whole text and highlights it.
+void BlockHighlighter::setText(const QString& text)
+{
+    priv->text = text;
+    priv->blocks.clear();
+    priv->split(text, priv->blocks);
+    priv->layout();
+    priv->rescan(0, priv->blocks.size() - 1);
+}
+
+/// Replaces \a removed characters at \a position with \a inserted, and
+/// updates the highlights of the blocks affected by the edit.
+void BlockHighlighter::replace(int position, int removed, const QString& inserted)
+{
+    position = qBound(0, position, priv->text.length());
+    removed = qBound(0, removed, priv->text.length() - position);
+
+    const int first = priv->blockAt(position);
+    const int last = priv->blockAt(position + removed);
+    const int from = priv->starts[first];
+    const int to = priv->starts[last] + priv->blocks[last].length;
+
+    priv->text.replace(position, removed, inserted);
+
+    // Blocks from the start of the first edited block to the end of the last
+    // one are replaced with the blocks of the same range in the new text.
+    QList<Block> edited;
+    priv->split(priv->text.mid(from, to - from + inserted.length() - removed), edited);
+    for (int i = first; i <= last; ++i)
+        priv->blocks.removeAt(first);
+    for (int i = 0; i < edited.size(); ++i)
+        priv->blocks.insert(first + i, edited[i]);
+    priv->layout();
+
+    // A match in the previous block may continue into the edited range.
+    priv->rescan(qMax(0, first - 1), first + edited.size() - 1);
+}
+
+/// Returns the text.
+QString BlockHighlighter::text() const
+{
+    return priv->text;
+}
+
+/// Returns the number of blocks, which is one more than the number of line
+/// breaks in the text.
+int BlockHighlighter::blockCount() const
+{
+    return priv->blocks.size();
+}
+
+/// Returns the (start, length) pairs of the highlights which start in
+/// \a block.  The start is relative to the start of the block.
+QList<QPair<int, int> > BlockHighlighter::blockHighlights(int block) const
+{
+    if (block < 0 || block >= priv->blocks.size())
+        return QList<QPair<int, int> >();
+    return priv->blocks[block].matches;
+}
+
+/// Returns the (start, length) pairs of all the highlights in the text, like
+/// Action::findHighlights() does.
+QList<QPair<int, int> > BlockHighlighter::highlights() const
+{
+    QList<QPair<int, int> > result;
+    for (int i = 0; i < priv->blocks.size(); ++i) {
+        const QList<QPair<int, int> >& matches = priv->blocks[i].matches;
+        for (int j = 0; j < matches.size(); ++j)
+            result << qMakePair(priv->starts[i] + matches[j].first, matches[j].second);
+    }
+    return result;
+}
+
+/// Returns how many blocks were scanned by the last setText() or replace().
+int BlockHighlighter::rescannedBlocks() const
+{
+    return priv->rescanned;
+}
+
+} // end namespace ContentAction
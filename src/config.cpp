@@ -22,7 +22,11 @@
 
 #include <stdlib.h>
 
+#include <QCryptographicHash>
+#include <QDataStream>
 #include <QDebug>
+#include <QMutex>
+#include <QMutexLocker>
 #include <QXmlDefaultHandler>
 #include <QRegularExpression>
 #include <QDir>
@@ -35,25 +39,30 @@ namespace {
 using namespace ContentAction;
 using namespace ContentAction::Internal;
 
-// mime type -> regexp
-static QList<QPair<QString, QRegularExpression> > Highlighter_cfg;
-// raw data for Highlighter_cfg
-static QHash<QString, QString> mimeToRegexp;
-static QHash<QString, QString> mimeToParent;
+// The configuration in use, read when it is first needed and replaced by
+// reloadHighlighterConfig()
+static QMutex configMutex;
+static HighlighterConfig *currentConfig = 0;
 
-/// Returns the path where the action configuration files should be read from.
-/// It may be overridden via the $CONTENTACTION_ACTIONS environment variable.
-static QString actionPath()
+// The rules of the highlight table files generated by data/gen-hltable
+const quint32 TableMagic = 0x4c434148;
+const quint32 TableVersion = 2;
+
+struct HighlightRule
 {
-    const char *path = ::getenv("CONTENTACTION_ACTIONS");
-    if (!path)
-        path = DEFAULT_ACTIONS;
-    return QString(path);
-}
+    QString name;
+    QString regexp;
+    QString parent;
+    qint32 priority;
+};
 
 struct ConfigReader: public QXmlDefaultHandler
 {
-    ConfigReader() : state(inLimbo) {}
+    ConfigReader(QHash<QString, QString> *mimeToRegexp,
+                 QHash<QString, QString> *mimeToParent,
+                 QHash<QString, int> *mimeToPriority)
+        : state(inLimbo), mimeToRegexp(mimeToRegexp), mimeToParent(mimeToParent),
+          mimeToPriority(mimeToPriority) {}
 
     bool startElement(const QString& ns, const QString& name, const QString& qname, const QXmlAttributes &atts);
     bool endElement(const QString& nsuri, const QString& name, const QString& qname);
@@ -76,6 +85,10 @@ struct ConfigReader: public QXmlDefaultHandler
     QString condName;
     QString sparqlSnippet;
     QString error;
+    // raw data for the rules of the configuration
+    QHash<QString, QString> *mimeToRegexp;
+    QHash<QString, QString> *mimeToParent;
+    QHash<QString, int> *mimeToPriority;
 };
 
 #define fail(msg)     \
@@ -106,10 +119,17 @@ bool ConfigReader::startElement(const QString& ns, const QString& name,
             QString mime = atts.value("name").trimmed();
             if (mime.isEmpty())
                 fail("expected a nonempy mimetype");
-            mimeToRegexp.insert(mime, regexp);
+            mimeToRegexp->insert(mime, regexp);
             QString parentRegexp = atts.value("specialCaseOf");
             if (!parentRegexp.isEmpty())
-                mimeToParent.insert(mime, parentRegexp);
+                mimeToParent->insert(mime, parentRegexp);
+            QString priority = atts.value("priority");
+            if (!priority.isEmpty()) {
+                bool ok;
+                mimeToPriority->insert(mime, priority.toInt(&ok));
+                if (!ok)
+                    fail("expected an integer priority");
+            }
         } else {
             fail("unexpected tag");
         }
@@ -144,9 +164,11 @@ bool ConfigReader::endElement(const QString& nsuri, const QString& name,
 
 #undef fail
 
-// Constructs Highlighter_cfg from mimeToRegexp and mimeToParent.
+// Constructs the rules of \a config from mimeToRegexp and mimeToParent.
 // Sorts the regexps topologically so that the special cases appear before the general cases.
-static void sortRegexps()
+static void sortRegexps(QHash<QString, QString>& mimeToRegexp,
+                        const QHash<QString, QString>& mimeToParent,
+                        HighlighterConfig& config)
 {
     // Insert the regexps in the wrong order (parent first, parent is the more
     // general regexp).  But always prepend, so the list will be in the right
@@ -174,32 +196,93 @@ static void sortRegexps()
         QRegularExpression expression(rule);
 
         if (expression.isValid()) {
-            Highlighter_cfg.prepend(qMakePair(QString(HighlighterMimeClass) + toInsert, expression));
+            config.rules.prepend(qMakePair(QString(HighlighterMimeClass) + toInsert, expression));
+            if (mimeToParent.contains(toInsert))
+                config.parents.insert(QString(HighlighterMimeClass) + toInsert,
+                                      QString(HighlighterMimeClass) + mimeToParent.value(toInsert));
         } else {
             qWarning() << "Invalid highlight rule:" << rule << "-- " << expression.errorString();
         }
     }
 }
 
-static void readConfig()
+// Reads the highlight rules of the configuration file \a xmlPath from the
+// table generated from it at build time, which has the rules already in
+// their final order.  Returns false if there is no table, or if it was
+// generated from another version of the file.  That is checked with a hash
+// of the whole file, so the file is read, but not parsed; the times of
+// installed files cannot be relied on.
+static bool readTable(const QString& xmlPath, QList<HighlightRule>& rules)
 {
-    static bool read = false;
+    QString tablePath = xmlPath;
+    tablePath.replace(tablePath.length() - 4, 4, ".hltable");
+    QFile table(tablePath);
+    if (!table.open(QIODevice::ReadOnly))
+        return false;
+    QDataStream in(&table);
+    in.setVersion(QDataStream::Qt_5_0);
+    quint32 magic, version;
+    QByteArray hash;
+    in >> magic >> version >> hash;
+    if (in.status() != QDataStream::Ok || magic != TableMagic || version != TableVersion)
+        return false;
 
-    if (read)
-        return;
-    read = true;
+    QFile xml(xmlPath);
+    if (!xml.open(QIODevice::ReadOnly)
+        || QCryptographicHash::hash(xml.readAll(), QCryptographicHash::Sha1) != hash)
+        return false;
+
+    quint32 count;
+    in >> count;
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        HighlightRule rule;
+        in >> rule.name >> rule.regexp >> rule.parent >> rule.priority;
+        rules << rule;
+    }
+    if (in.status() != QDataStream::Ok) {
+        LCA_WARNING << "broken highlight table" << tablePath;
+        rules.clear();
+        return false;
+    }
+    return true;
+}
+
+static HighlighterConfig readConfig()
+{
+    HighlighterConfig config;
+    QHash<QString, QString> mimeToRegexp;
+    QHash<QString, QString> mimeToParent;
+    QHash<QString, int> mimeToPriority;
 
-    QDir dir(actionPath());
+    QDir dir(highlighterConfigPath());
     if (!dir.isReadable()) {
         LCA_WARNING << "cannot read actions from" << dir.path();
-        return;
+        return config;
     }
     dir.setNameFilters(QStringList("*.xml"));
     QStringList confFiles = dir.entryList(QDir::Files);
+    QList<HighlightRule> tableRules;
+    int tables = 0;
+    int xmlFiles = 0;
     Q_FOREACH (const QString& confFile, confFiles) {
+        QList<HighlightRule> rules;
+        if (readTable(dir.filePath(confFile), rules)) {
+            Q_FOREACH (const HighlightRule& rule, rules) {
+                mimeToRegexp.insert(rule.name, rule.regexp);
+                if (!rule.parent.isEmpty())
+                    mimeToParent.insert(rule.name, rule.parent);
+                if (rule.priority != 0)
+                    mimeToPriority.insert(rule.name, rule.priority);
+            }
+            tableRules += rules;
+            ++tables;
+            continue;
+        }
+
         QFile file(dir.filePath(confFile));
+        ++xmlFiles;
 
-        ConfigReader handler;
+        ConfigReader handler(&mimeToRegexp, &mimeToParent, &mimeToPriority);
         QXmlSimpleReader reader;
         reader.setContentHandler(&handler);
         reader.setErrorHandler(&handler);
@@ -209,19 +292,81 @@ static void readConfig()
         }
     }
 
-    // Sort the regexps topologically: each regexp (e.g., a specialized url)
-    // before its parent (e.g., a more general url)
-    sortRegexps();
-    mimeToRegexp.clear();
-    mimeToParent.clear();
+    if (tables == 1 && xmlFiles == 0) {
+        // The rules of a single table are already sorted.  The table
+        // generator checks the regexps with Python, which accepts some that
+        // PCRE doesn't, so they are checked again like those of the XML.
+        Q_FOREACH (const HighlightRule& rule, tableRules) {
+            QRegularExpression expression(rule.regexp);
+            if (!expression.isValid()) {
+                qWarning() << "Invalid highlight rule:" << rule.regexp << "-- "
+                           << expression.errorString();
+                continue;
+            }
+            config.rules.append(qMakePair(QString(HighlighterMimeClass) + rule.name,
+                                          expression));
+            if (!rule.parent.isEmpty())
+                config.parents.insert(QString(HighlighterMimeClass) + rule.name,
+                                      QString(HighlighterMimeClass) + rule.parent);
+        }
+    } else {
+        // Sort the regexps topologically: each regexp (e.g., a specialized url)
+        // before its parent (e.g., a more general url)
+        sortRegexps(mimeToRegexp, mimeToParent, config);
+    }
+    QHashIterator<QString, int> it(mimeToPriority);
+    while (it.hasNext()) {
+        it.next();
+        config.priorities.insert(QString(HighlighterMimeClass) + it.key(), it.value());
+    }
+    return config;
 }
 
 } // end anon namespace
 
+/// Returns the path where the action configuration files should be read from.
+/// It may be overridden via the $CONTENTACTION_ACTIONS environment variable.
+QString ContentAction::Internal::highlighterConfigPath()
+{
+    const char *path = ::getenv("CONTENTACTION_ACTIONS");
+    if (!path)
+        path = DEFAULT_ACTIONS;
+    return QString(path);
+}
+
+/// Returns the highlighter configuration in use, reading the configuration
+/// files if they have not been read yet.
+HighlighterConfig ContentAction::Internal::currentHighlighterConfig()
+{
+    QMutexLocker locker(&configMutex);
+    if (!currentConfig)
+        currentConfig = new HighlighterConfig(readConfig());
+    return *currentConfig;
+}
+
+/// Reads the configuration files again, and replaces the configuration in
+/// use with what they have now.  Returns the new configuration.
+HighlighterConfig ContentAction::Internal::reloadHighlighterConfig()
+{
+    HighlighterConfig config = readConfig();
+    QMutexLocker locker(&configMutex);
+    if (currentConfig)
+        *currentConfig = config;
+    else
+        currentConfig = new HighlighterConfig(config);
+    return config;
+}
+
 /// Returns the highlighter configuration map of (mimetype, regexp) read from
 /// the configuration files.
-const QList<QPair<QString, QRegularExpression> >& ContentAction::Internal::highlighterConfig()
+QList<QPair<QString, QRegularExpression> > ContentAction::Internal::highlighterConfig()
+{
+    return currentHighlighterConfig().rules;
+}
+
+/// Returns the map of highlighter mimetypes to the more general mimetypes they
+/// are declared to be special cases of.
+QHash<QString, QString> ContentAction::Internal::highlighterParents()
 {
-    readConfig();
-    return Highlighter_cfg;
+    return currentHighlighterConfig().parents;
 }
@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+#include "configwatcher.h"
+#include "internal.h"
+#include "highlight.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QPointer>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <QTimer>
+
+namespace ContentAction {
+namespace Internal {
+
+namespace {
+
+// How long the changes to the configuration are collected before the
+// scanner is rebuilt, in milliseconds
+const int SettleTime = 200;
+
+QMutex instanceMutex;
+// the watcher, which is deleted with the application
+QPointer<ConfigWatcher> instance;
+
+} // end anon namespace
+
+// Builds the new scanner away from the thread of the watcher.
+class ConfigRebuild : public QRunnable
+{
+public:
+    explicit ConfigRebuild(bool reload) : reload(reload) {}
+
+    void run()
+    {
+        if (reload)
+            reloadHighlighter();
+        else
+            refreshHighlighter();
+        ConfigWatcher::finished();
+    }
+
+private:
+    bool reload;
+};
+
+ConfigWatcher::ConfigWatcher()
+    : watcher(0), timer(0), rebuilding(false), configChanged(false),
+      associationsChanged(false)
+{
+}
+
+bool ConfigWatcher::start()
+{
+    QCoreApplication *app = QCoreApplication::instance();
+    if (!app)
+        return false;
+    QMutexLocker locker(&instanceMutex);
+    if (!instance) {
+        ConfigWatcher *configWatcher = new ConfigWatcher;
+        configWatcher->moveToThread(app->thread());
+        configWatcher->setParent(app);
+        instance = configWatcher;
+        if (QThread::currentThread() == app->thread())
+            configWatcher->watch();
+        else
+            QMetaObject::invokeMethod(configWatcher, "watch", Qt::QueuedConnection);
+    }
+    return true;
+}
+
+// Adds the directories and the files in them to the watched paths.  Files
+// which were replaced instead of modified have dropped out, so this is done
+// again after each rebuild.
+void ConfigWatcher::watch()
+{
+    if (!watcher) {
+        watcher = new QFileSystemWatcher(this);
+        timer = new QTimer(this);
+        timer->setSingleShot(true);
+        timer->setInterval(SettleTime);
+        connect(watcher, &QFileSystemWatcher::directoryChanged, this, &ConfigWatcher::changed);
+        connect(watcher, &QFileSystemWatcher::fileChanged, this, &ConfigWatcher::changed);
+        connect(timer, &QTimer::timeout, this, &ConfigWatcher::rebuild);
+    }
+
+    QStringList paths;
+    QDir dir(highlighterConfigPath());
+    configPath = dir.absolutePath();
+    if (dir.exists()) {
+        if (!ancestorPath.isEmpty()) {
+            watcher->removePath(ancestorPath);
+            ancestorPath.clear();
+        }
+        paths << configPath;
+        dir.setNameFilters(QStringList() << "*.xml" << "*.hltable");
+        Q_FOREACH (const QString& file, dir.entryList(QDir::Files))
+            paths << dir.absoluteFilePath(file);
+    } else {
+        QString ancestor = QFileInfo(configPath).absolutePath();
+        while (!QFileInfo(ancestor).isDir() && !QDir(ancestor).isRoot())
+            ancestor = QFileInfo(ancestor).absolutePath();
+        if (!ancestorPath.isEmpty() && ancestorPath != ancestor)
+            watcher->removePath(ancestorPath);
+        ancestorPath = ancestor;
+        paths << ancestorPath;
+    }
+    Q_FOREACH (const QString& path, mimeAssociationDirs()) {
+        QDir associations(path);
+        if (!associations.exists())
+            continue;
+        paths << associations.absolutePath();
+        associations.setNameFilters(QStringList() << "mimeinfo.cache" << "mimeapps.list"
+                                                  << "defaults.list");
+        Q_FOREACH (const QString& file, associations.entryList(QDir::Files))
+            paths << associations.absoluteFilePath(file);
+    }
+    const QStringList watched = watcher->directories() + watcher->files();
+    Q_FOREACH (const QString& path, paths) {
+        if (!watched.contains(path))
+            watcher->addPath(path);
+    }
+}
+
+void ConfigWatcher::changed(const QString& path)
+{
+    if (path == ancestorPath) {
+        // the configuration directory, or one above it, may have been
+        // created; that is a change of the configuration once it is there
+        watch();
+        if (!ancestorPath.isEmpty())
+            return;
+        configChanged = true;
+    } else if (path == configPath || QFileInfo(path).absolutePath() == configPath) {
+        configChanged = true;
+    } else {
+        associationsChanged = true;
+    }
+    timer->start();
+}
+
+// Starts rebuilding the scanner, unless a rebuild is running already; then
+// rebuilt() starts another one.  A change of the configuration reads it
+// again, which checks the handlers too.
+void ConfigWatcher::rebuild()
+{
+    if (rebuilding || !(configChanged || associationsChanged))
+        return;
+    rebuilding = true;
+    QThreadPool::globalInstance()->start(new ConfigRebuild(configChanged));
+    configChanged = false;
+    associationsChanged = false;
+}
+
+void ConfigWatcher::rebuilt()
+{
+    rebuilding = false;
+    watch();
+    rebuild();
+}
+
+// Called by ConfigRebuild when the new scanner is in use.
+void ConfigWatcher::finished()
+{
+    QMutexLocker locker(&instanceMutex);
+    if (instance)
+        QMetaObject::invokeMethod(instance.data(), "rebuilt", Qt::QueuedConnection);
+}
+
+} // end namespace Internal
+} // end namespace ContentAction
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef CONFIGWATCHER_H
+#define CONFIGWATCHER_H
+
+#include <QObject>
+#include <QString>
+
+class QFileSystemWatcher;
+class QTimer;
+
+namespace ContentAction {
+namespace Internal {
+
+// Watches the directory of the highlighter configuration, and rebuilds the
+// highlight scanner on the global thread pool when the files in it change.
+// The directories of the mime associations are watched too: when they
+// change, the categories which have handlers are checked again.  The
+// changes are collected for a moment first, so that installing several
+// files at once rebuilds the scanner only once.  While the configuration
+// directory does not exist, the closest directory above it which does is
+// watched instead, so that the configuration directory is picked up when it
+// is created.  The watcher lives in the thread of the application.
+class ConfigWatcher : public QObject
+{
+    Q_OBJECT
+public:
+    // Starts watching if there is an application.  Returns false if there
+    // is none yet.
+    static bool start();
+
+private Q_SLOTS:
+    void watch();
+    void changed(const QString& path);
+    void rebuild();
+    void rebuilt();
+
+private:
+    ConfigWatcher();
+    static void finished();
+    friend class ConfigRebuild;
+
+    QFileSystemWatcher *watcher;
+    QTimer *timer;
+    QString configPath;
+    // the directory watched for configPath to appear, or empty if it exists
+    QString ancestorPath;
+    bool rebuilding;
+    // what has changed since the last rebuild started
+    bool configChanged;
+    bool associationsChanged;
+};
+
+} // end namespace Internal
+} // end namespace ContentAction
+
+#endif
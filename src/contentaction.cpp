@@ -62,6 +62,7 @@ const QString XOssoServiceKey("Desktop Entry/X-Osso-Service");
 const QString XMaemoMethodKey("Desktop Entry/X-Maemo-Method");
 const QString XMaemoObjectPathKey("Desktop Entry/X-Maemo-Object-Path");
 const QString ExecKey("Desktop Entry/Exec");
+const QString DBusActivatableKey("Desktop Entry/DBusActivatable");
 const QString URLKey("Desktop Entry/URL");
 const QString TypeKeyValueLink("Link");
 
@@ -130,6 +131,11 @@ QString ActionPrivate::icon() const
     return "NOT_IMPLEMENTED";
 }
 
+QString ActionPrivate::launchKey() const
+{
+    return QString();
+}
+
 void ActionPrivate::trigger(bool) const
 {
     LCA_WARNING << "triggered an invalid action, not doing anything.";
@@ -165,6 +171,12 @@ QString DefaultPrivate::icon() const
     return desktopEntry->icon();
 }
 
+// Identifies the (handler, params) pair for collapsing duplicate triggers.
+QString DefaultPrivate::launchKey() const
+{
+    return desktopEntry->fileName() + QLatin1Char('\n') + params.join(QLatin1Char('\n'));
+}
+
 Action::Action()
     : d(new ActionPrivate())
 {
@@ -221,6 +233,9 @@ Action createAction(QSharedPointer<MDesktopEntry> desktopEntry,
              desktopEntry->contains(XOssoServiceKey)) {
         return Action(new DBusPrivate(desktopEntry, params));
     }
+    else if (desktopEntry->value(DBusActivatableKey) == "true") {
+        return Action(new ActivatablePrivate(desktopEntry, params));
+    }
     else if (desktopEntry->contains(ExecKey)) {
         return Action(new ExecPrivate(desktopEntry, params));
     }
@@ -235,10 +250,29 @@ Action::~Action()
 }
 
 /// Triggers the action represented by this object, using the URIs contained
-/// by the Action object.
+/// by the Action object.  Triggering the same application with the same
+/// parameters again within a short time (see setDuplicateTriggerWindow()) is
+/// ignored.  The launch is queued if too many launches are already in
+/// progress, see setLaunchConcurrency().
 void Action::trigger() const
 {
-    d->trigger(false);
+    trigger(UserLaunch);
+}
+
+/// Triggers the action like trigger(), queueing it with the given \a priority
+/// if it can't be launched right away.  User initiated launches are started
+/// before background ones.  Returns false if the launch queue is full and the
+/// action was not triggered, which only happens to background launches.
+bool Action::trigger(LaunchPriority priority) const
+{
+    if (!d->isValid()) {
+        d->trigger(false);
+        return false;
+    }
+    QString key = d->launchKey();
+    if (!admitLaunch(key))
+        return true;
+    return scheduleLaunch(d, key, priority);
 }
 
 /// Triggers the action represented by this object, using the URIs contained by
@@ -247,7 +281,10 @@ void Action::trigger() const
 /// only possible when the application is launched via D-Bus.
 void Action::triggerAndWait() const
 {
-    d->trigger(true);
+    if (!d->isValid())
+        d->trigger(true);
+    else if (admitLaunch(d->launchKey()))
+        runLaunch(d);
 }
 
 /// Returns \a true if the Action object represents an action which can be
@@ -23,10 +23,12 @@
 #define CONTENTACTION_H
 
 #include <QList>
+#include <QMap>
 #include <QString>
 #include <QStringList>
 #include <QUrl>
 #include <QSharedPointer>
+#include <QVector>
 
 #ifndef LCA_EXPORT
 # if defined(LCA_BUILD)
@@ -37,13 +39,47 @@
 #endif
 
 class MDesktopEntry;
+class QAtomicInt;
+class QIODevice;
+class QThreadPool;
 
 namespace ContentAction
 {
 
 struct Match;
+struct HighlightMatch;
+struct MatchTemplate;
 struct ActionPrivate;
 
+struct LCA_EXPORT HighlightOptions {
+    HighlightOptions();
+
+    QThreadPool *threadPool; ///< if set, large texts are scanned in parallel on it
+    int timeout; ///< milliseconds the scan may take, or -1 for no limit
+    const QAtomicInt *cancel; ///< if set, the scan stops when this becomes non-zero
+    QStringList categories; ///< the highlighter mimetypes to match, or empty for all
+    bool keepOverlaps; ///< if set, the matches of all categories are returned, even overlapping
+};
+
+struct LCA_EXPORT HighlightBatch {
+    QVector<int> text; ///< index of the text of each match
+    QVector<int> start; ///< where each match starts in its text
+    QVector<int> length; ///< length of each match
+    QVector<int> category; ///< category of each match, an index into categories
+    QStringList categories; ///< the highlighter mimetypes
+};
+
+enum HighlightEngine {
+    GeneratedEngine, ///< a scanner generated from the built-in rules at build time
+    AutomatonEngine, ///< an automaton which takes linear time
+    BacktrackingEngine ///< PCRE, giving up on texts which take too much work
+};
+
+enum LaunchPriority {
+    UserLaunch, ///< started by the user, goes ahead of background launches
+    BackgroundLaunch ///< may wait, or be refused when the queue is full
+};
+
 class LCA_EXPORT Action
 {
 public:
@@ -71,8 +107,23 @@ public:
                                  const QStringList& params);
 
     static QList<Match> highlight(const QString &text);
+    static QList<HighlightMatch> highlight(const QString &text, const HighlightOptions& options,
+                                           bool *truncated = 0);
+    static QList<HighlightMatch> highlightUtf8(const QByteArray& text,
+                                               QList<QPair<int, int> > *utf16 = 0);
     static QList<QPair<int, int> > findHighlights(const QString& text);
+    static QList<QPair<int, int> > findHighlightsUtf8(const QByteArray& text,
+                                                      QList<QPair<int, int> > *utf16 = 0);
+    static QList<QPair<int, int> > findHighlights(const QString& text,
+                                                  const HighlightOptions& options,
+                                                  bool *truncated = 0);
+    static HighlightBatch findHighlights(const QStringList& texts,
+                                         const HighlightOptions& options,
+                                         bool *truncated = 0);
     static QPair<int, int> findNextHighlight(const QString& text, int start = 0);
+    static QPair<int, int> findNextHighlight(const QString& text, int start,
+                                             const HighlightOptions& options,
+                                             bool *truncated = 0);
 
     Action();
     ~Action();
@@ -80,6 +131,7 @@ public:
     Action& operator=(const Action& other);
 
     void trigger() const;
+    bool trigger(LaunchPriority priority) const;
     void triggerAndWait() const;
 
 private:
@@ -100,11 +152,87 @@ struct LCA_EXPORT Match {
     bool operator<(const Match& other) const;
 };
 
+struct LCA_EXPORT HighlightMatch {
+    int start, end; ///< [start, end) determines the matching substring
+    QString category; ///< the highlighter mimetype which matched
+
+    QList<Action> applicableActions() const;
+    bool operator<(const HighlightMatch& other) const;
+
+private:
+    friend struct MatchTemplate;
+    // what the matches of the category in the text have in common
+    QSharedPointer<MatchTemplate> d;
+};
+
 LCA_EXPORT QList<Action> actionsForMime(const QString& mimeType);
 LCA_EXPORT Action defaultActionForMime(const QString& mimeType);
 LCA_EXPORT void setMimeDefault(const QString& mimeType, const Action& action);
 LCA_EXPORT void setMimeDefault(const QString& mimeType, const QString& app);
 LCA_EXPORT void resetMimeDefault(const QString& mimeType);
 
+LCA_EXPORT QMap<QString, HighlightEngine> highlightEngines();
+
+struct LCA_EXPORT HighlightCacheStatistics {
+    quint64 hits; ///< calls answered from the cache
+    quint64 misses; ///< calls which had to scan the text
+    int entries; ///< texts in the cache
+};
+
+LCA_EXPORT void setHighlightCacheSize(int entries);
+LCA_EXPORT HighlightCacheStatistics highlightCacheStatistics();
+
+class LCA_EXPORT BlockHighlighter
+{
+public:
+    BlockHighlighter();
+    ~BlockHighlighter();
+
+    void setText(const QString& text);
+    void replace(int position, int removed, const QString& inserted);
+    QString text() const;
+
+    int blockCount() const;
+    QList<QPair<int, int> > blockHighlights(int block) const;
+    QList<QPair<int, int> > highlights() const;
+    int rescannedBlocks() const;
+
+private:
+    Q_DISABLE_COPY(BlockHighlighter)
+    struct Private;
+    Private *priv;
+};
+
+class LCA_EXPORT HighlightReader
+{
+public:
+    explicit HighlightReader(QIODevice *device, int overlap = 4096);
+    ~HighlightReader();
+
+    bool readNext(qint64 *start, QString *text, QString *category);
+    QList<Action> actions() const;
+
+private:
+    Q_DISABLE_COPY(HighlightReader)
+    struct Private;
+    Private *priv;
+};
+
+struct LCA_EXPORT LaunchStatistics {
+    quint64 launched; ///< triggers which resulted in a launch
+    quint64 suppressed; ///< duplicate triggers collapsed into an earlier launch
+    quint64 rejected; ///< triggers refused or dropped because the queue was full
+    int running; ///< launches in progress
+    int queued; ///< launches waiting for a free slot
+    int peakQueued; ///< the longest the queue has been
+};
+
+LCA_EXPORT void setDuplicateTriggerWindow(int msecs);
+LCA_EXPORT void setLaunchConcurrency(int maxRunning);
+LCA_EXPORT int launchConcurrency();
+LCA_EXPORT void setLaunchQueueLimit(int maxQueued);
+LCA_EXPORT int launchQueueLimit();
+LCA_EXPORT LaunchStatistics launchStatistics();
+
 } // end namespace
 #endif
@@ -22,8 +22,9 @@
 #include "internal.h"
 
 #include <MDesktopEntry>
-#include <MRemoteAction>
 
+#include <QDBusConnection>
+#include <QDBusPendingCallWatcher>
 #include <QVariantList>
 
 using namespace ContentAction::Internal;
@@ -47,6 +48,7 @@ DBusPrivate::DBusPrivate(QSharedPointer<MDesktopEntry> desktopEntry,
         objectPath = "/";
         method = "mime_open";
         varArgs = true;
+        buildMessage();
         return;
     }
     // Now we assume that X-Maemo-Service is present.
@@ -81,9 +83,12 @@ DBusPrivate::DBusPrivate(QSharedPointer<MDesktopEntry> desktopEntry,
 #endif
     fixedArgs.append(params);
     params = fixedArgs;
+    buildMessage();
 }
 
-void DBusPrivate::trigger(bool wait) const
+// Constructs the method call once; triggering only needs to send a copy of
+// it.
+void DBusPrivate::buildMessage()
 {
     QVariantList arguments;
     if (varArgs) {
@@ -92,15 +97,40 @@ void DBusPrivate::trigger(bool wait) const
             arguments << param;
         }
     } else {
-        arguments.append(params);
+        arguments << QVariant(params);
     }
 
-    MRemoteAction action(busName, objectPath, iface, method, arguments);
-    if (wait) {
-        action.triggerAndWait();
-    } else {
-        action.trigger();
-    }
+    message = QDBusMessage::createMethodCall(busName, objectPath, iface, method);
+    message.setArguments(arguments);
+}
+
+void DBusPrivate::trigger(bool wait) const
+{
+    if (method.isEmpty())
+        return;
+
+    QDBusPendingCall call = QDBusConnection::sessionBus().asyncCall(message);
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(call);
+    const QString target = busName;
+    const QString name = method;
+    // The launch is in progress until the application has replied.
+    Internal::LaunchSlotRef slot = Internal::currentLaunchSlot();
+
+    QObject::connect(watcher, &QDBusPendingCallWatcher::finished,
+                     [target, name, slot](QDBusPendingCallWatcher *w) mutable {
+        if (w->isError()) {
+            LCA_WARNING << "error reply from" << target
+                        << "when calling" << name << ":"
+                        << w->error().message();
+        }
+        slot.clear();
+        w->deleteLater();
+    });
+
+    // Delivers the finished() signal synchronously, so waiting and
+    // asynchronous completion are handled by the same code.
+    if (wait)
+        watcher->waitForFinished();
 }
 
 } // end namespace ContentAction
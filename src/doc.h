@@ -178,6 +178,39 @@ x-maemo-highlight/email-address and \c x-maemo-nepomuk/phone-number.
 </actions>
 \endcode
 
+Fragments of text may be matched by the regexps of several categories.  By
+default the category which matches first in the text wins, and a special case
+wins over its general category when they match at the same position.  A
+\c priority attribute on \c highlight changes this: of overlapping matches,
+the one of the category with the higher priority is kept.  A category without
+a priority has the one of the category it is a special case of, or 0.
+
+\code
+<actions>
+  <highlight regexp="\d{3}-\d{4}" name="phone-number" priority="10"/>
+</actions>
+\endcode
+
+An .xml file may be accompanied by a table generated from it with
+\c data/gen-hltable, like \c highlight1.hltable next to
+\c highlight1.xml.  The library then loads the rules from the table
+instead of parsing the XML.  A table which was generated from another
+version of the .xml file is ignored.
+
+The regular expressions of \c highlight1.xml are also compiled into
+deterministic scanners by \c data/gen-scanners when the library is built.
+The library matches the built-in regular expressions with the scanners, and
+the other ones with an automaton; both take time linear in the length of the
+text they look at.  Only regular expressions the automaton does not support,
+like ones with backreferences, are matched with PCRE, which gives up on a
+text that makes it backtrack too much.  \c lca-tool \c --highlightengines
+shows which engine matches each category.
+
+A running application picks up changes to the configuration directory: when
+.xml or .hltable files are added, changed or removed there, the rules are
+read again and the highlighter is rebuilt in the background.  Highlighting
+calls which are already running finish with the old rules.
+
 Applications can now define in their .desktop files that they handle these
 custom MIME types.  When launched, they get a string which matches the regular
 expression as a parameter. For example, an application handling
@@ -145,6 +145,12 @@ void ExecPrivate::trigger(bool) const
         return;
     }
     // Ignore whether the user wanted to wait for the application to start.
+    launch(appInfo, params);
+}
+
+// Spawns the Exec line of \a appInfo with \a params as the URIs.
+void ExecPrivate::launch(GDesktopAppInfo *appInfo, const QStringList& params)
+{
     GError *error = 0;
     GList *uris = NULL;
 
@@ -19,13 +19,22 @@
  */
 #include "contentaction.h"
 #include "internal.h"
+#include "highlight.h"
+#include "configwatcher.h"
 
+#include <QAtomicInt>
+#include <QHash>
 #include <QList>
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
 #include <QString>
 #include <QRegularExpression>
 #include <QPair>
 #include <QDebug>
 
+#include <algorithm>
+
 typedef QPair<QString, QRegularExpression> MimeAndRegexp;
 
 namespace {
@@ -33,56 +42,489 @@ namespace {
 using namespace ContentAction;
 using namespace ContentAction::Internal;
 
-QList<MimeAndRegexp> regExpsInUse()
+QList<MimeAndRegexp> regExpsInUse(const HighlighterConfig& config)
 {
     // Returns the regexps for which we have actions.
-    static QList<MimeAndRegexp> mars;
-    static bool read = false;
-
-    if (!read) {
-        QListIterator<QPair<QString, QRegularExpression> > iter(highlighterConfig());
-        while (iter.hasNext()) {
-            const QPair<QString, QRegularExpression> &mar = iter.next();
-            if (!appsForContentType(mar.first).isEmpty())
-                mars += MimeAndRegexp(mar.first, mar.second);
-        }
-        read = true;
+    QList<MimeAndRegexp> mars;
+    QListIterator<QPair<QString, QRegularExpression> > iter(config.rules);
+    while (iter.hasNext()) {
+        const QPair<QString, QRegularExpression> &mar = iter.next();
+        if (!appsForContentType(mar.first).isEmpty())
+            mars += MimeAndRegexp(mar.first, mar.second);
     }
     return mars;
 }
 
-QRegularExpression combine(const QList<MimeAndRegexp> &mars)
+// Compiles the patterns of a scanner which has its categories, mime types
+// and patterns set.  The backends of previous are reused where the regexps
+// of an engine are still the same.  Only the full scanner keeps its PCRE
+// regexp in the disk cache, which holds one regexp.
+void compile(HighlightScanner *scanner,
+             const QList<QSharedPointer<const HighlightBackend> >& previous,
+             CompiledRegexp::CacheMode mode = CompiledRegexp::UseCache)
 {
     QString re("(?:");
-    bool first = true;
-    Q_FOREACH (const MimeAndRegexp &mr, mars) {
-        if (!first)
+    int group = 1;
+    Q_FOREACH (const QString& pattern, scanner->patterns) {
+        if (group > 1)
             re += '|';
-        re += mr.second.pattern();
-        first = false;
+        re += '(' + pattern + ')';
+        scanner->groups << group;
+        // the wrapping group and the groups of the category itself
+        group += 1 + QRegularExpression(pattern).captureCount();
     }
     re += ")";
-    return QRegularExpression(re);
+    scanner->master = QRegularExpression(re);
+    scanner->backends = createBackends(scanner->patterns, previous, mode);
+    scanner->prefilter = Prefilter(scanner->patterns);
+    static QAtomicInt generations;
+    scanner->generation = generations.fetchAndAddRelaxed(1) + 1;
+}
+
+// Builds the scanner out of the regexps in use, which are already sorted so
+// that special cases come before the general cases; with leftmost-first
+// alternation the special case wins when both match at the same position.
+HighlightScanner combine(const QList<MimeAndRegexp> &mars, const HighlighterConfig& config,
+                         const QList<QSharedPointer<const HighlightBackend> >& previous)
+{
+    HighlightScanner scanner;
+    Q_FOREACH (const MimeAndRegexp &mr, mars) {
+        QStringList mimes(mr.first);
+        QString parent = config.parents.value(mr.first);
+        while (!parent.isEmpty() && !mimes.contains(parent)) {
+            mimes << parent;
+            parent = config.parents.value(parent);
+        }
+        int priority = 0;
+        Q_FOREACH (const QString& mime, mimes) {
+            if (config.priorities.contains(mime)) {
+                priority = config.priorities.value(mime);
+                break;
+            }
+        }
+        scanner.categories << mr.first;
+        scanner.mimeTypes << mimes;
+        scanner.patterns << mr.second.pattern();
+        scanner.priorities << priority;
+    }
+    compile(&scanner, previous);
+    return scanner;
+}
+
+// Builds a scanner of the given categories of full, keeping their order.
+// A general category matches what its special cases would have matched if
+// they are left out, but its matches get the actions they had in full.
+HighlightScanner subset(const HighlightScanner& full, const QStringList& categories)
+{
+    HighlightScanner scanner;
+    for (int i = 0; i < full.categories.size(); ++i) {
+        if (categories.contains(full.categories[i])) {
+            scanner.categories << full.categories[i];
+            scanner.mimeTypes << full.mimeTypes[i];
+            scanner.patterns << full.patterns[i];
+            scanner.priorities << full.priorities.value(i);
+        }
+    }
+    compile(&scanner, full.backends, CompiledRegexp::NoCache);
+    return scanner;
+}
+
+QSharedPointer<const HighlightScanner> build(const HighlighterConfig& config,
+                                             const QList<MimeAndRegexp>& mars,
+                                             const QSharedPointer<const HighlightScanner>& previous)
+{
+    QList<QSharedPointer<const HighlightBackend> > backends;
+    if (previous)
+        backends = previous->backends;
+    return QSharedPointer<const HighlightScanner>(
+        new HighlightScanner(combine(mars, config, backends)));
 }
 
+// The scanner in use.  Callers take a reference to it, so replacing it
+// doesn't disturb the scans which are still running with the old one.
+struct ScannerState
+{
+    ScannerState() : watching(false), subsetsOf(0) {}
+
+    QMutex mutex;
+    QSharedPointer<const HighlightScanner> scanner;
+    bool watching;
+    // the scanners of the subsets of categories asked for, by the
+    // generation of the scanner they were made from and the joined
+    // categories, and the generation of the scanner in use then
+    QHash<QPair<int, QString>, QSharedPointer<const HighlightScanner> > subsets;
+    int subsetsOf;
+    // serializes the reloads, so that the last one is the one which stays
+    QMutex reloadMutex;
+};
+
+Q_GLOBAL_STATIC(ScannerState, scannerState)
+
 } // end anon namespace
 
 namespace ContentAction {
 namespace Internal {
 
-QRegularExpression masterRegexp()
+HighlightScanner::HighlightScanner()
+    : generation(0)
+{
+}
+
+bool HighlightScanner::isEmpty() const
+{
+    return categories.isEmpty();
+}
+
+bool HighlightScanner::hasPriorities() const
 {
-    static QRegularExpression master;
-    static bool read = false;
-    if (!read) {
-        master = combine(regExpsInUse());
-        read = true;
+    for (int i = 1; i < priorities.size(); ++i) {
+        if (priorities[i] != priorities[0])
+            return true;
+    }
+    return false;
+}
+
+int HighlightScanner::next(const QString& text, int start,
+                           int *matchStart, int *matchLength,
+                           QVector<BackendMatch> *found) const
+{
+    if (isEmpty())
+        return -1;
+    if (!backends.isEmpty()) {
+        if (found && found->size() != backends.size()) {
+            BackendMatch none = { -1, -1, 0, 0 };
+            found->fill(none, backends.size());
+        }
+        int category = -1;
+        for (int i = 0; i < backends.size(); ++i) {
+            BackendMatch m;
+            // The first match at or after an earlier position is also the
+            // first one at or after start, unless it starts before start.
+            if (found && (*found)[i].from != -1 && (*found)[i].from <= start
+                && ((*found)[i].category == -1 || (*found)[i].start >= start)) {
+                m = (*found)[i];
+            } else {
+                m.from = start;
+                m.category = backends[i]->next(text, start, &m.start, &m.length);
+                if (m.category != -1)
+                    m.category = backends[i]->categories()[m.category];
+                if (found)
+                    (*found)[i] = m;
+            }
+            if (m.category == -1)
+                continue;
+            if (category == -1 || m.start < *matchStart
+                || (m.start == *matchStart && m.category < category)) {
+                category = m.category;
+                *matchStart = m.start;
+                *matchLength = m.length;
+            }
+        }
+        return category;
     }
-    return master;
+    QRegularExpressionMatch match = master.match(text, start);
+    if (!match.hasMatch())
+        return -1;
+    *matchStart = match.capturedStart();
+    *matchLength = match.capturedLength();
+    for (int i = 0; i < groups.size(); ++i) {
+        if (match.capturedStart(groups[i]) != -1)
+            return i;
+    }
+    return -1;
+}
+
+HighlightBudget::HighlightBudget(const HighlightOptions& options)
+    : timeout(options.timeout), cancel(options.cancel), exhausted(false)
+{
+    if (timeout >= 0)
+        timer.start();
+}
+
+bool HighlightBudget::isLimited() const
+{
+    return timeout >= 0 || cancel;
+}
+
+bool HighlightBudget::isExhausted() const
+{
+    if (!exhausted)
+        exhausted = (cancel && cancel->load())
+            || (timeout >= 0 && timer.hasExpired(timeout));
+    return exhausted;
+}
+
+HighlightCursor::HighlightCursor(const HighlightScanner& scanner,
+                                 const QString& text, int from,
+                                 const HighlightBudget *budget)
+    : scanner(scanner), text(text), pos(from), budget(budget), truncated(false),
+      filtered(scanner.prefilter.isEnabled()), window(0), contextStart(0),
+      contextWindow(-1)
+{
+    if (filtered)
+        windows = scanner.prefilter.windows(text);
+}
+
+bool HighlightCursor::isTruncated() const
+{
+    return truncated;
+}
+
+// Returns true if the budget has run out, and remembers it.
+bool HighlightCursor::stop()
+{
+    if (budget && budget->isExhausted())
+        truncated = true;
+    return truncated;
+}
+
+int HighlightCursor::next(int *matchStart, int *matchLength)
+{
+    if (stop())
+        return -1;
+    if (!filtered) {
+        int category = scanner.next(text, pos, matchStart, matchLength, &found);
+        if (category != -1)
+            advance(*matchStart, *matchLength);
+        return category;
+    }
+
+    // All the matches lie within the windows, and the regexps see the same
+    // text around them as in the whole text, so matching each window on its
+    // own finds the same matches.
+    const int margin = scanner.prefilter.context();
+    for (; window < windows.size(); ++window) {
+        const QPair<int, int>& w = windows[window];
+        if (pos >= w.second)
+            continue;
+        if (contextWindow != window) {
+            if (contextWindow != -1 && stop())
+                return -1;
+            contextStart = qMax(0, w.first - margin);
+            int contextEnd = qMin(text.length(), w.second + margin);
+            // don't split surrogate pairs
+            if (contextStart > 0 && text.at(contextStart).isLowSurrogate())
+                --contextStart;
+            if (contextEnd < text.length() && text.at(contextEnd).isLowSurrogate())
+                ++contextEnd;
+            context = text.mid(contextStart, contextEnd - contextStart);
+            contextWindow = window;
+            found.clear();
+        }
+        int from = qMax(pos, w.first);
+        if (from > 0 && from < text.length() && text.at(from).isLowSurrogate()
+            && text.at(from - 1).isHighSurrogate())
+            ++from;
+        int category = scanner.next(context, from - contextStart, matchStart, matchLength,
+                                    &found);
+        if (category != -1 && *matchStart + contextStart < w.second) {
+            *matchStart += contextStart;
+            advance(*matchStart, *matchLength);
+            return category;
+        }
+    }
+    return -1;
+}
+
+void HighlightCursor::advance(int matchStart, int matchLength)
+{
+    pos = matchStart + matchLength;
+    if (matchLength == 0)
+        // regexp matched an empty string, avoid the inifinite loop
+        ++pos;
+}
+
+// Returns the scanner of the current highlighter configuration, building
+// it on the first call.  Once there is an application, the configuration
+// directory is watched, and the scanner is rebuilt when it changes.
+QSharedPointer<const HighlightScanner> highlightScanner()
+{
+    ScannerState *state = scannerState();
+    QMutexLocker locker(&state->mutex);
+    if (!state->scanner) {
+        const HighlighterConfig config = currentHighlighterConfig();
+        state->scanner = build(config, regExpsInUse(config),
+                               QSharedPointer<const HighlightScanner>());
+    }
+    if (!state->watching)
+        state->watching = ConfigWatcher::start();
+    return state->scanner;
+}
+
+// Returns a scanner of those of the current scanner's categories which are
+// in \a categories, or the current scanner itself if that is all of them,
+// or if \a categories is empty.  The scanners of the subsets are kept until
+// the current scanner is replaced, so leaving categories out makes the
+// scans cheaper after the first call.
+QSharedPointer<const HighlightScanner> highlightScanner(const QStringList& categories)
+{
+    const QSharedPointer<const HighlightScanner> full = highlightScanner();
+    if (categories.isEmpty())
+        return full;
+    const QSharedPointer<const HighlightScanner> scanner = highlightScanner(*full, categories);
+    return scanner ? scanner : full;
+}
+
+// Returns a scanner of those of the categories of \a scanner which are in
+// \a categories, or null if that is all of them.  The subsets are made from
+// \a scanner itself, so a scan which holds on to a scanner that has been
+// replaced meanwhile does not mix in the rules of the new one.  They are
+// kept until the current scanner is replaced, unless \a scanner is older
+// than the current one.
+QSharedPointer<const HighlightScanner> highlightScanner(const HighlightScanner& scanner,
+                                                        const QStringList& categories)
+{
+    QStringList selected;
+    Q_FOREACH (const QString& category, scanner.categories) {
+        if (categories.contains(category))
+            selected << category;
+    }
+    if (selected.size() == scanner.categories.size())
+        return QSharedPointer<const HighlightScanner>();
+
+    ScannerState *state = scannerState();
+    const QPair<int, QString> key(scanner.generation, selected.join(" "));
+    int current;
+    {
+        QMutexLocker locker(&state->mutex);
+        current = state->scanner ? state->scanner->generation : 0;
+        if (state->subsetsOf == current && state->subsets.contains(key))
+            return state->subsets.value(key);
+    }
+    QSharedPointer<const HighlightScanner> result(new HighlightScanner(subset(scanner, selected)));
+    QMutexLocker locker(&state->mutex);
+    if (scanner.generation < current || !state->scanner
+        || state->scanner->generation != current)
+        // scanner is not the current one or made from it, or the current one
+        // was replaced meanwhile
+        return result;
+    if (state->subsetsOf != current) {
+        state->subsets.clear();
+        state->subsetsOf = current;
+    }
+    state->subsets.insert(key, result);
+    return result;
+}
+
+namespace {
+
+// The order in which selectHighlights() takes the candidates
+struct ByPriority
+{
+    explicit ByPriority(const HighlightScanner& scanner) : scanner(scanner) {}
+
+    bool operator()(const Highlight& a, const Highlight& b) const
+    {
+        const int pa = scanner.priorities.value(a.category);
+        const int pb = scanner.priorities.value(b.category);
+        if (pa != pb)
+            return pa > pb;
+        if (a.start != b.start)
+            return a.start < b.start;
+        return a.category < b.category;
+    }
+
+    const HighlightScanner& scanner;
+};
+
+// Whether the match a, which starts at start, runs into position; an empty
+// match takes up its position, like in the single pass
+inline bool covers(int start, const Highlight& a, int position)
+{
+    return position < start + qMax(a.length, 1);
+}
+
+} // end anon namespace
+
+// Returns those of the matches of each category in candidates which are
+// kept where they overlap, ordered by their start.  The candidates are taken
+// by descending priority, and at the same priority by their start, and each
+// is kept unless it overlaps one which is kept already.  So of overlapping
+// matches the one of the higher priority is kept, at the same priority the
+// one which starts first, and at the same start the one of the category
+// which comes first, so a special case wins over its general category like
+// in the single pass.
+QVector<Highlight> selectHighlights(const HighlightScanner& scanner,
+                                   const QVector<Highlight>& candidates)
+{
+    QVector<Highlight> ordered = candidates;
+    std::sort(ordered.begin(), ordered.end(), ByPriority(scanner));
+    // the matches kept, by their start
+    QMap<int, Highlight> kept;
+    Q_FOREACH (const Highlight& h, ordered) {
+        QMap<int, Highlight>::const_iterator after = kept.lowerBound(h.start);
+        if (after != kept.constEnd() && covers(h.start, h, after.key()))
+            continue;
+        if (after != kept.constBegin()) {
+            QMap<int, Highlight>::const_iterator before = after - 1;
+            if (covers(before.key(), before.value(), h.start))
+                continue;
+        }
+        kept.insert(h.start, h);
+    }
+    return kept.values().toVector();
+}
+
+// Finds the matches of each category in text from \a from on, with the
+// scanners of the single categories, and selects them like above.
+QVector<Highlight> selectHighlights(const HighlightScanner& scanner, const QString& text,
+                                   int from)
+{
+    QVector<Highlight> candidates;
+    for (int i = 0; i < scanner.categories.size(); ++i) {
+        const QSharedPointer<const HighlightScanner> single =
+            highlightScanner(scanner, QStringList(scanner.categories[i]));
+        HighlightCursor cursor(single ? *single : scanner, text, from);
+        Highlight h;
+        h.category = i;
+        while (cursor.next(&h.start, &h.length) != -1)
+            candidates << h;
+    }
+    return selectHighlights(scanner, candidates);
+}
+
+// Reads the highlighter configuration again and replaces the scanner with
+// one built from it.  The scanner is built before taking the lock, so
+// highlightScanner() callers don't wait for it.
+void reloadHighlighter()
+{
+    ScannerState *state = scannerState();
+    QMutexLocker reloading(&state->reloadMutex);
+    const QSharedPointer<const HighlightScanner> previous = highlightScanner();
+    const HighlighterConfig config = reloadHighlighterConfig();
+    QSharedPointer<const HighlightScanner> scanner =
+        build(config, regExpsInUse(config), previous);
+    QMutexLocker locker(&state->mutex);
+    state->scanner = scanner;
+}
+
+// Checks again which categories of the configuration have handlers, and
+// replaces the scanner if that has changed.  The configuration files are
+// not read again, and the compiled regexps of the engines whose categories
+// stay the same are reused.
+void refreshHighlighter()
+{
+    ScannerState *state = scannerState();
+    QMutexLocker reloading(&state->reloadMutex);
+    const QSharedPointer<const HighlightScanner> previous = highlightScanner();
+    const HighlighterConfig config = currentHighlighterConfig();
+    const QList<MimeAndRegexp> mars = regExpsInUse(config);
+    QStringList categories;
+    Q_FOREACH (const MimeAndRegexp& mr, mars)
+        categories << mr.first;
+    if (categories == previous->categories)
+        return;
+    QSharedPointer<const HighlightScanner> scanner = build(config, mars, previous);
+    QMutexLocker locker(&state->mutex);
+    state->scanner = scanner;
+}
+
+QRegularExpression masterRegexp()
+{
+    return highlightScanner()->master;
 }
 
 } // end namespace Internal
 } // end namespace ContentAction
 
 Q_DECLARE_METATYPE(ContentAction::Action);
-
@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef HIGHLIGHT_H
+#define HIGHLIGHT_H
+
+#include "backends.h"
+#include "prefilter.h"
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QRegularExpression>
+#include <QSharedPointer>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+namespace ContentAction {
+
+// What the matches of one category in one text have in common.  The desktop
+// files are looked up only when the actions of a match are asked for, and
+// then once for all the matches.
+struct MatchTemplate
+{
+    MatchTemplate(const QString& text, const QStringList& mimeTypes);
+    MatchTemplate(const QByteArray& utf8, const QStringList& mimeTypes);
+    const QStringList& desktopFiles() const;
+    // the matched fragment of the text
+    QString fragment(int start, int end) const;
+    // makes the template the one of match
+    static void attach(HighlightMatch *match, const QSharedPointer<MatchTemplate>& t);
+
+    QString text;
+    // the text if it was given in UTF-8, with byte offsets
+    QByteArray utf8;
+    bool isUtf8;
+    QStringList mimeTypes;
+    mutable bool resolved;
+    mutable QStringList desktops;
+};
+
+namespace Internal {
+
+// What the backends of a scanner found in a text: the first match of each
+// at or after from, or category -1 if there was none.
+struct BackendMatch
+{
+    int from;
+    int category;
+    int start;
+    int length;
+};
+
+// A match of a scanner: the fragment and the index of its category
+struct Highlight
+{
+    int start;
+    int length;
+    int category;
+};
+
+// Matches the regexps of all highlighter categories which have actions in a
+// single pass.  Each category is an alternative of one master regexp, wrapped
+// in a capture group of its own, so the group which participated in the
+// match tells the category without matching again.  The backends match the
+// categories with the engines which suit them, and the earliest of their
+// matches wins, like the alternatives of master.
+struct LCA_EXPORT HighlightScanner
+{
+    HighlightScanner();
+    bool isEmpty() const;
+    // Whether the categories have different priorities, so that their
+    // matches must be found separately and selected with selectHighlights()
+    bool hasPriorities() const;
+    // Finds the first match at or after \a start.  Returns the index of the
+    // matching category and sets \a matchStart and \a matchLength, or returns
+    // -1 if there are no more matches.  Calls for the same text can pass
+    // \a found, so that the backends don't search again for the matches
+    // they already found further on.
+    int next(const QString& text, int start,
+             int *matchStart, int *matchLength,
+             QVector<BackendMatch> *found = 0) const;
+
+    QRegularExpression master;
+    // the engines matching the categories; master is used if there are
+    // none
+    QList<QSharedPointer<const HighlightBackend> > backends;
+    // highlighter mime types, in the order of the alternatives
+    QStringList categories;
+    // the regexp of each category
+    QStringList patterns;
+    // the priority of each category, which it inherits from the categories
+    // it is a special case of unless it has one of its own
+    QList<int> priorities;
+    // the category and the more general categories it is a special case of
+    QList<QStringList> mimeTypes;
+    // capture group of each alternative in master
+    QList<int> groups;
+    // where in a text the alternatives can match
+    Prefilter prefilter;
+    // tells apart the scanners: compile() gives each scanner, subsets too, a
+    // new one, and later scanners get higher ones; 0 if not compiled
+    int generation;
+};
+
+// Tells when a scan has run out of the time or has been cancelled, as
+// given by the timeout and cancel of HighlightOptions.  The time runs from
+// the construction.
+class LCA_EXPORT HighlightBudget
+{
+public:
+    explicit HighlightBudget(const HighlightOptions& options);
+    bool isLimited() const;
+    // Once this has returned true, it keeps returning true.
+    bool isExhausted() const;
+
+private:
+    QElapsedTimer timer;
+    int timeout;
+    const QAtomicInt *cancel;
+    mutable bool exhausted;
+};
+
+// Iterates over the matches of a scanner in a text, like repeated
+// HighlightScanner::next() calls which continue from the end of the
+// previous match.  If the prefilter is enabled, the master regexp is run
+// only on the windows of the text where something can match.
+class LCA_EXPORT HighlightCursor
+{
+public:
+    HighlightCursor(const HighlightScanner& scanner, const QString& text, int from = 0,
+                    const HighlightBudget *budget = 0);
+    // Like HighlightScanner::next().  Returns -1 also when the budget has
+    // run out, which is checked before each match and each window.
+    int next(int *matchStart, int *matchLength);
+    // Whether next() stopped because the budget ran out
+    bool isTruncated() const;
+
+private:
+    void advance(int matchStart, int matchLength);
+    bool stop();
+
+    const HighlightScanner& scanner;
+    const QString& text;
+    int pos;
+    const HighlightBudget *budget;
+    bool truncated;
+    bool filtered;
+    QVector<QPair<int, int> > windows;
+    int window;
+    // what the backends found in the text, or in the context of the
+    // current window
+    QVector<BackendMatch> found;
+    // the current window with the context around it
+    QString context;
+    int contextStart;
+    int contextWindow;
+};
+
+LCA_EXPORT QSharedPointer<const HighlightScanner> highlightScanner();
+LCA_EXPORT QSharedPointer<const HighlightScanner> highlightScanner(const QStringList& categories);
+LCA_EXPORT QSharedPointer<const HighlightScanner> highlightScanner(const HighlightScanner& scanner,
+                                                                   const QStringList& categories);
+LCA_EXPORT QVector<Highlight> selectHighlights(const HighlightScanner& scanner,
+                                              const QVector<Highlight>& candidates);
+LCA_EXPORT QVector<Highlight> selectHighlights(const HighlightScanner& scanner,
+                                              const QString& text, int from = 0);
+LCA_EXPORT void reloadHighlighter();
+LCA_EXPORT void refreshHighlighter();
+QStringList desktopFilesFor(const QStringList& mimeTypes);
+
+} // end namespace Internal
+} // end namespace ContentAction
+
+#endif
@@ -20,46 +20,766 @@
  */
 #include "contentaction.h"
 #include "internal.h"
+#include "highlight.h"
 
 #include <QDebug>
 #include <QRegularExpression>
 #include <QPair>
 #include <QDBusInterface>
+#include <QCache>
 #include <QCoreApplication>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThreadPool>
+#include <QVector>
+
+#include <algorithm>
 
 namespace ContentAction {
 
 using namespace ContentAction::Internal;
 
+namespace {
+
+// Texts are split for parallel scanning only if the chunks would be at
+// least this long.
+const int MinParallelChunk = 64 * 1024;
+
+// How much text around a chunk the regexps may need to see.  A match may
+// run over the end of its chunk by this much at most.
+const int ChunkContext = 4096;
+
+// Scans the matches starting in [from, to) of a text, assuming that no match
+// runs into the range from before it.  If the budget runs out, result has
+// the matches up to where the scan stopped.
+class ChunkScan : public QRunnable
+{
+public:
+    ChunkScan(const HighlightScanner& scanner, const QString& text, int from, int to,
+              const HighlightBudget *budget, QSemaphore *done)
+        : scanner(scanner), text(text), from(from), to(to), budget(budget),
+          truncated(false), done(done) {}
+
+    void run()
+    {
+        const int windowStart = qMax(0, from - ChunkContext);
+        const QString window = text.mid(windowStart, to + ChunkContext - windowStart);
+        HighlightCursor cursor(scanner, window, from - windowStart, budget);
+        Highlight h;
+        while ((h.category = cursor.next(&h.start, &h.length)) != -1
+               && h.start + windowStart < to) {
+            h.start += windowStart;
+            result << h;
+        }
+        truncated = cursor.isTruncated();
+        done->release();
+    }
+
+    const HighlightScanner& scanner;
+    const QString& text;
+    int from, to;
+    const HighlightBudget *budget;
+    bool truncated;
+    QSemaphore *done;
+    QVector<Highlight> result;
+};
+
+QVector<Highlight> scanInParallel(const HighlightScanner& scanner, const QString& text,
+                                  QThreadPool *pool, const HighlightBudget *budget,
+                                  bool *truncated)
+{
+    QVector<Highlight> result;
+    if (scanner.isEmpty())
+        return result;
+
+    // Split at whitespace, so that a match rarely runs over the boundary.
+    int chunks = qBound(1, qMin(pool->maxThreadCount() * 2,
+                                text.length() / MinParallelChunk), 256);
+    int chunkLength = text.length() / chunks;
+    QVector<int> bounds;
+    bounds << 0;
+    for (int i = 1; i < chunks; ++i) {
+        int pos = qMax(bounds.last(), i * chunkLength);
+        int limit = qMin(text.length(), pos + ChunkContext);
+        while (pos < limit && !text.at(pos).isSpace())
+            ++pos;
+        if (pos > bounds.last() && pos < text.length())
+            bounds << pos;
+    }
+    // An empty match at the very end of the text belongs to the last chunk.
+    bounds << text.length() + 1;
+
+    QSemaphore done;
+    QList<ChunkScan*> scans;
+    for (int i = 0; i + 1 < bounds.size(); ++i) {
+        ChunkScan *scan = new ChunkScan(scanner, text, bounds[i], bounds[i + 1], budget,
+                                        &done);
+        scan->setAutoDelete(false);
+        scans << scan;
+        pool->start(scan);
+    }
+    done.acquire(scans.size());
+
+    // Merge in order.  If a match of the previous chunk ran into this one,
+    // the chunk's own scan started from the wrong place: scan again from
+    // the end of that match until a match coincides with the chunk's, from
+    // where on they are the same.  The result ends where the first chunk
+    // which ran out of the budget stopped.
+    int pos = 0;
+    for (int i = 0; i < scans.size(); ++i) {
+        const QVector<Highlight>& found = scans[i]->result;
+        int next = 0;
+        if (scans[i]->truncated && pos > scans[i]->from) {
+            *truncated = true;
+            break;
+        }
+        if (pos > scans[i]->from) {
+            const int windowStart = qMax(0, scans[i]->from - ChunkContext);
+            const QString window =
+                text.mid(windowStart, scans[i]->to + ChunkContext - windowStart);
+            Highlight h;
+            while (true) {
+                h.category = scanner.next(window, pos - windowStart, &h.start, &h.length);
+                if (h.category == -1 || h.start + windowStart >= scans[i]->to) {
+                    next = found.size();
+                    break;
+                }
+                h.start += windowStart;
+                while (next < found.size() && found[next].start < h.start)
+                    ++next;
+                if (next < found.size() && found[next].start == h.start
+                    && found[next].length == h.length)
+                    break;
+                result << h;
+                pos = h.start + h.length;
+                if (h.length == 0)
+                    ++pos;
+            }
+        }
+        for (; next < found.size(); ++next) {
+            result << found[next];
+            pos = found[next].start + found[next].length;
+            if (found[next].length == 0)
+                ++pos;
+        }
+        if (scans[i]->truncated) {
+            *truncated = true;
+            break;
+        }
+    }
+    qDeleteAll(scans);
+    return result;
+}
+
+// Finds the matches of the scanner in text in a single pass, in parallel if
+// a pool is given and the text is long enough.
+QVector<Highlight> scanPass(const HighlightScanner& scanner, const QString& text,
+                            QThreadPool *pool, const HighlightBudget *budget,
+                            bool *truncated)
+{
+    *truncated = false;
+    if (pool && text.length() >= 2 * MinParallelChunk)
+        return scanInParallel(scanner, text, pool, budget, truncated);
+
+    QVector<Highlight> result;
+    HighlightCursor cursor(scanner, text, 0, budget);
+    Highlight h;
+    while ((h.category = cursor.next(&h.start, &h.length)) != -1)
+        result << h;
+    *truncated = cursor.isTruncated();
+    return result;
+}
+
+// The order of Match::operator<, and of the categories at the same span
+bool byPosition(const Highlight& a, const Highlight& b)
+{
+    if (a.start != b.start)
+        return a.start < b.start;
+    if (a.length != b.length)
+        return a.length < b.length;
+    return a.category < b.category;
+}
+
+// Groups the matches by category, for the deprecated Action::highlight()
+bool byCategory(const Highlight& a, const Highlight& b)
+{
+    return a.category < b.category;
+}
+
+// Finds the matches of each category in text with a cursor of its own.  The
+// cursors are advanced together, always the one whose match starts first,
+// so if the budget runs out, the result has the matches of all the
+// categories which start before the point where the scan stopped.
+QVector<Highlight> scanInLockstep(const HighlightScanner& scanner, const QString& text,
+                                  const HighlightBudget *budget, bool *truncated)
+{
+    const int count = scanner.categories.size();
+    QList<QSharedPointer<const HighlightScanner> > singles;
+    QList<HighlightCursor *> cursors;
+    // the next match of each category, or -1 as the category at the end
+    QVector<Highlight> pending(count);
+    *truncated = false;
+    for (int i = 0; i < count && !*truncated; ++i) {
+        singles << highlightScanner(scanner, QStringList(scanner.categories[i]));
+        cursors << new HighlightCursor(singles[i] ? *singles[i] : scanner, text, 0, budget);
+        pending[i].category =
+            cursors[i]->next(&pending[i].start, &pending[i].length) == -1 ? -1 : i;
+        *truncated = cursors[i]->isTruncated();
+    }
+
+    QVector<Highlight> result;
+    while (!*truncated) {
+        int first = -1;
+        for (int i = 0; i < count; ++i) {
+            if (pending[i].category != -1
+                && (first == -1 || pending[i].start < pending[first].start))
+                first = i;
+        }
+        if (first == -1)
+            break;
+        result << pending[first];
+        if (cursors[first]->next(&pending[first].start, &pending[first].length) == -1) {
+            pending[first].category = -1;
+            *truncated = cursors[first]->isTruncated();
+        }
+    }
+    qDeleteAll(cursors);
+    return result;
+}
+
+// Finds the matches in text with the budget.  Usually this is a single pass
+// of the scanner, which gives the matches in order and without overlaps.
+// If the overlaps are kept, or the categories have priorities, the matches
+// of each category are found on their own, and then selected by priority
+// unless the overlaps are kept.  That takes a pass over the text for each
+// category, with scanners of the single categories made from scanner, which
+// are kept while scanner is the one in use.  If the budget can run out, the
+// categories are scanned in lockstep instead, without the thread pool, so
+// that a truncated result has the matches up to some point of the text.
+QVector<Highlight> scanText(const HighlightScanner& scanner, const QString& text,
+                            QThreadPool *pool, const HighlightBudget *budget,
+                            bool keepOverlaps, bool *truncated)
+{
+    if (!keepOverlaps && !scanner.hasPriorities())
+        return scanPass(scanner, text, pool, budget, truncated);
+
+    QVector<Highlight> candidates;
+    *truncated = false;
+    if (budget && budget->isLimited()) {
+        candidates = scanInLockstep(scanner, text, budget, truncated);
+    } else {
+        for (int i = 0; i < scanner.categories.size(); ++i) {
+            const QSharedPointer<const HighlightScanner> single =
+                highlightScanner(scanner, QStringList(scanner.categories[i]));
+            QVector<Highlight> found = scanPass(single ? *single : scanner, text, pool, budget,
+                                                truncated);
+            for (int j = 0; j < found.size(); ++j) {
+                found[j].category = i;
+                candidates << found[j];
+            }
+        }
+    }
+    if (keepOverlaps) {
+        std::sort(candidates.begin(), candidates.end(), byPosition);
+        return candidates;
+    }
+    return selectHighlights(scanner, candidates);
+}
+
+// Finds the matches in text, in parallel if options allow it.
+QVector<Highlight> scan(const HighlightScanner& scanner, const QString& text,
+                        const HighlightOptions& options, bool *truncated)
+{
+    HighlightBudget budget(options);
+    return scanText(scanner, text, options.threadPool, &budget, options.keepOverlaps,
+                    truncated);
+}
+
+// Appends the matches in texts [from, to) to batch.  Returns false if the
+// budget ran out.
+bool scanBatch(const HighlightScanner& scanner, const QStringList& texts, int from, int to,
+               const HighlightBudget *budget, bool keepOverlaps, HighlightBatch *batch)
+{
+    if (keepOverlaps || scanner.hasPriorities()) {
+        for (int i = from; i < to; ++i) {
+            bool truncated;
+            Q_FOREACH (const Highlight& h, scanText(scanner, texts[i], 0, budget,
+                                                    keepOverlaps, &truncated)) {
+                batch->text << i;
+                batch->start << h.start;
+                batch->length << h.length;
+                batch->category << h.category;
+            }
+            if (truncated)
+                return false;
+        }
+        return true;
+    }
+
+    int start, length, category;
+    for (int i = from; i < to; ++i) {
+        HighlightCursor cursor(scanner, texts[i], 0, budget);
+        while ((category = cursor.next(&start, &length)) != -1) {
+            batch->text << i;
+            batch->start << start;
+            batch->length << length;
+            batch->category << category;
+        }
+        if (cursor.isTruncated())
+            return false;
+    }
+    return true;
+}
+
+// Scans the texts [from, to) of a batch.
+class BatchScan : public QRunnable
+{
+public:
+    BatchScan(const HighlightScanner& scanner, const QStringList& texts, int from, int to,
+              const HighlightBudget *budget, bool keepOverlaps, QSemaphore *done)
+        : scanner(scanner), texts(texts), from(from), to(to), budget(budget),
+          keepOverlaps(keepOverlaps), truncated(false), done(done) {}
+
+    void run()
+    {
+        truncated = !scanBatch(scanner, texts, from, to, budget, keepOverlaps, &result);
+        done->release();
+    }
+
+    const HighlightScanner& scanner;
+    const QStringList& texts;
+    int from, to;
+    const HighlightBudget *budget;
+    bool keepOverlaps;
+    bool truncated;
+    QSemaphore *done;
+    HighlightBatch result;
+};
+
+// Scans the texts in parallel, in runs of texts about as long as the chunks
+// of a long text.  Returns false if the budget ran out.
+bool scanBatchInParallel(const HighlightScanner& scanner, const QStringList& texts,
+                         int totalLength, QThreadPool *pool, const HighlightBudget *budget,
+                         bool keepOverlaps, HighlightBatch *batch)
+{
+    int chunks = qBound(1, qMin(pool->maxThreadCount() * 2,
+                                totalLength / MinParallelChunk), 256);
+    const int chunkLength = totalLength / chunks;
+
+    QSemaphore done;
+    QList<BatchScan*> scans;
+    int from = 0, length = 0;
+    for (int i = 0; i < texts.size(); ++i) {
+        length += texts[i].length();
+        if (length >= chunkLength || i + 1 == texts.size()) {
+            BatchScan *scan = new BatchScan(scanner, texts, from, i + 1, budget,
+                                            keepOverlaps, &done);
+            scan->setAutoDelete(false);
+            scans << scan;
+            pool->start(scan);
+            from = i + 1;
+            length = 0;
+        }
+    }
+    done.acquire(scans.size());
+
+    // The result ends with the first run which ran out of the budget.
+    bool complete = true;
+    for (int i = 0; i < scans.size() && complete; ++i) {
+        batch->text += scans[i]->result.text;
+        batch->start += scans[i]->result.start;
+        batch->length += scans[i]->result.length;
+        batch->category += scans[i]->result.category;
+        complete = !scans[i]->truncated;
+    }
+    qDeleteAll(scans);
+    return complete;
+}
+
+struct CachedHighlights
+{
+    // generation of the scanner which found the matches
+    int generation;
+    QVector<Highlight> highlights;
+};
+
+// The complete results of the latest texts, if enabled with
+// setHighlightCacheSize().  The keys are the categories of the scanner and
+// the text, so that scans of some of the categories don't replace the
+// matches of the others, and a hash collision can't return the matches of
+// another text.  Each entry costs 1, so the size is a number of texts
+// whatever their length.
+struct HighlightCache
+{
+    HighlightCache()
+        : entries(0)
+    {
+        stats.hits = 0;
+        stats.misses = 0;
+        stats.entries = 0;
+    }
+
+    QMutex mutex;
+    QCache<QPair<QString, QString>, CachedHighlights> entries;
+    HighlightCacheStatistics stats;
+};
+
+Q_GLOBAL_STATIC(HighlightCache, highlightCache)
+
+// Like scan(), but takes the matches from the cache if they are there, and
+// stores them there if the scan was complete.  Results with the overlaps
+// are not cached.
+QVector<Highlight> findAll(const HighlightScanner& scanner, const QString& text,
+                           const HighlightOptions& options, bool *truncated)
+{
+    if (options.keepOverlaps)
+        return scan(scanner, text, options, truncated);
+
+    const int generation = scanner.generation;
+    const QPair<QString, QString> key(scanner.categories.join(" "), text);
+    HighlightCache *cache = highlightCache();
+    {
+        QMutexLocker locker(&cache->mutex);
+        if (cache->entries.maxCost() > 0) {
+            CachedHighlights *cached = cache->entries.object(key);
+            if (cached && cached->generation == generation) {
+                ++cache->stats.hits;
+                *truncated = false;
+                return cached->highlights;
+            }
+            ++cache->stats.misses;
+        }
+    }
+
+    QVector<Highlight> result = scan(scanner, text, options, truncated);
+    if (!*truncated) {
+        QMutexLocker locker(&cache->mutex);
+        if (cache->entries.maxCost() > 0) {
+            CachedHighlights *cached = new CachedHighlights;
+            cached->generation = generation;
+            cached->highlights = result;
+            cache->entries.insert(key, cached, 1);
+        }
+    }
+    return result;
+}
+
+// Makes the HighlightMatch objects of highlights found by scanner, with a
+// template like prototype shared by the matches of each category.
+QList<HighlightMatch> makeMatches(const HighlightScanner& scanner,
+                                  const QVector<Highlight>& highlights,
+                                  const MatchTemplate& prototype)
+{
+    QList<HighlightMatch> result;
+    // category -> template shared by its matches
+    QHash<int, QSharedPointer<MatchTemplate> > templates;
+    Q_FOREACH (const Highlight& h, highlights) {
+        QSharedPointer<MatchTemplate>& t = templates[h.category];
+        if (!t) {
+            t = QSharedPointer<MatchTemplate>(new MatchTemplate(prototype));
+            t->mimeTypes = scanner.mimeTypes[h.category];
+        }
+
+        HighlightMatch m;
+        m.category = scanner.categories[h.category];
+        m.start = h.start;
+        m.end = h.start + h.length;
+        MatchTemplate::attach(&m, t);
+        result << m;
+    }
+    return result;
+}
+
+// Decodes the UTF-8 character at pos of text.  Returns its length in
+// bytes; an invalid byte decodes to U+FFFD on its own.
+int decodeUtf8(const uchar *text, int length, int pos, uint *character)
+{
+    const uchar c = text[pos];
+    if (c < 0x80) {
+        *character = c;
+        return 1;
+    }
+    int bytes = 0;
+    uint least = 0;
+    uint u = 0;
+    if (c >= 0xc2 && c < 0xe0) {
+        bytes = 2;
+        least = 0x80;
+        u = c & 0x1f;
+    } else if (c >= 0xe0 && c < 0xf0) {
+        bytes = 3;
+        least = 0x800;
+        u = c & 0x0f;
+    } else if (c >= 0xf0 && c < 0xf5) {
+        bytes = 4;
+        least = 0x10000;
+        u = c & 0x07;
+    }
+    if (bytes && pos + bytes <= length) {
+        int i = 1;
+        for (; i < bytes && (text[pos + i] & 0xc0) == 0x80; ++i)
+            u = (u << 6) | (text[pos + i] & 0x3f);
+        if (i == bytes && u >= least && u <= 0x10ffff && (u < 0xd800 || u > 0xdfff)) {
+            *character = u;
+            return bytes;
+        }
+    }
+    *character = QChar::ReplacementCharacter;
+    return 1;
+}
+
+QString decodeUtf8(const uchar *text, int length)
+{
+    QString result;
+    result.reserve(length);
+    uint c;
+    for (int pos = 0; pos < length;) {
+        pos += decodeUtf8(text, length, pos, &c);
+        if (QChar::requiresSurrogates(c)) {
+            result += QChar(QChar::highSurrogate(c));
+            result += QChar(QChar::lowSurrogate(c));
+        } else {
+            result += QChar(c);
+        }
+    }
+    return result;
+}
+
+// Converts increasing offsets of a UTF-8 text between bytes and UTF-16 code
+// units, decoding the text like decodeUtf8().
+class Utf8Offsets
+{
+public:
+    Utf8Offsets(const uchar *text, int length)
+        : text(text), length(length), byte(0), unit(0) {}
+
+    int toByte(int offset)
+    {
+        while (unit < offset && byte < length)
+            step();
+        return byte;
+    }
+
+    int toUnit(int offset)
+    {
+        while (byte < offset && byte < length)
+            step();
+        return unit;
+    }
+
+private:
+    void step()
+    {
+        uint c;
+        byte += decodeUtf8(text, length, byte, &c);
+        unit += QChar::requiresSurrogates(c) ? 2 : 1;
+    }
+
+    const uchar *text;
+    int length;
+    int byte;
+    int unit;
+};
+
+// Finds the matches in a UTF-8 text, with byte offsets.  If all the
+// categories have generated scanners, they run on the bytes as they are;
+// the other engines get the text decoded to UTF-16.
+QVector<Highlight> findAllUtf8(const HighlightScanner& scanner, const QByteArray& text)
+{
+    const uchar *bytes = reinterpret_cast<const uchar *>(text.constData());
+    QVector<Highlight> result;
+    if (scanner.isEmpty())
+        return result;
+
+    if (scanner.backends.size() == 1 && !scanner.hasPriorities()
+        && scanner.backends.first()->engine() == GeneratedEngine) {
+        const GeneratedBackend *generated =
+            static_cast<const GeneratedBackend *>(scanner.backends.first().data());
+        Highlight h;
+        int pos = 0;
+        while ((h.category = generated->next(bytes, text.length(), pos,
+                                             &h.start, &h.length)) != -1) {
+            h.category = generated->categories()[h.category];
+            result << h;
+            pos = h.start + qMax(h.length, 1);
+        }
+        return result;
+    }
+
+    bool truncated;
+    result = findAll(scanner, decodeUtf8(bytes, text.length()), HighlightOptions(),
+                     &truncated);
+    Utf8Offsets offsets(bytes, text.length());
+    for (int i = 0; i < result.size(); ++i) {
+        Highlight& h = result[i];
+        const int start = offsets.toByte(h.start);
+        h.length = offsets.toByte(h.start + h.length) - start;
+        h.start = start;
+    }
+    return result;
+}
+
+// The UTF-16 offsets of highlights found with findAllUtf8()
+QList<QPair<int, int> > utf16Offsets(const QByteArray& text,
+                                     const QVector<Highlight>& highlights)
+{
+    QList<QPair<int, int> > result;
+    Utf8Offsets offsets(reinterpret_cast<const uchar *>(text.constData()), text.length());
+    Q_FOREACH (const Highlight& h, highlights) {
+        const int start = offsets.toUnit(h.start);
+        result << QPair<int, int>{start, offsets.toUnit(h.start + h.length) - start};
+    }
+    return result;
+}
+
+} // end anon namespace
+
+/// \struct ContentAction::HighlightOptions
+/// Options for finding highlights.
+
+HighlightOptions::HighlightOptions()
+    : threadPool(0), timeout(-1), cancel(0), keepOverlaps(false)
+{
+}
+
+/// \struct ContentAction::HighlightBatch
+/// The matches in a batch of texts, as parallel arrays with one element per
+/// match.
+
+/// \struct ContentAction::HighlightMatch
+/// A fragment found by the highlighter, with its category.  The actions of
+/// the fragment are created only when they are asked for.
+
 /// Highlights fragments of \a text which have applicable actions.
-/// Returns a list of Match objects.  \deprecated Use
-/// ContentAction::Action::findHighlights() instead.
+/// Returns a list of Match objects.  Like in earlier versions, each
+/// highlighter category is matched on its own, and all of their matches are
+/// returned, overlapping ones included, grouped by category in the order of
+/// the categories.  A fragment gets the actions of the category which
+/// matched it, and of the categories it is a special case of; they are
+/// created and stored in Match::actions.  The other overloads return
+/// HighlightMatch objects, which have the category of the match and create
+/// the actions only when they are asked for, and by default find the
+/// matches of all the categories in a single pass, without overlaps.
+///
+/// \deprecated Use ContentAction::Action::findHighlights() instead.
 QList<Match> Action::highlight(const QString& text)
 {
-    const QList<QPair<QString, QRegularExpression> >& cfg = highlighterConfig();
+    const QSharedPointer<const HighlightScanner> scanner = highlightScanner();
+    HighlightOptions options;
+    options.keepOverlaps = true;
+    bool truncated;
+    QVector<Highlight> highlights = findAll(*scanner, text, options, &truncated);
+    std::stable_sort(highlights.begin(), highlights.end(), byCategory);
+
     QList<Match> result;
+    Q_FOREACH (const HighlightMatch& h,
+               makeMatches(*scanner, highlights, MatchTemplate(text, QStringList()))) {
+        Match m;
+        m.start = h.start;
+        m.end = h.end;
+        m.actions = h.applicableActions();
+        result << m;
+    }
+    return result;
+}
 
-    for (int i = 0; i < cfg.size(); ++i) {
-        QStringList apps = appsForContentType(cfg[i].first);
-        const QRegularExpression &re = cfg[i].second;
-        QRegularExpressionMatchIterator it = re.globalMatch(text);
-
-        while (it.hasNext()) {
-            QRegularExpressionMatch match = it.next();
-            int pos = match.capturedStart();
-            int length = match.capturedLength();
-            Match m;
-            m.start = pos;
-            m.end = pos + length;
-
-            Q_FOREACH (const QString& app, apps) {
-                const QString &desktop = findDesktopFile(app);
-                if (desktop != "")
-                    m.actions << createAction(desktop, QStringList() << match.captured());
-            }
-            result << m;
+/// Highlights the fragments of \a text which findHighlights(const QString&,
+/// const HighlightOptions&, bool*) finds with the given \a options, in the
+/// order of the text, with their categories.  If the scan stops early, the
+/// result has the matches found until then, and \a truncated, if given, is
+/// set to true.  The actions of the matches are created only when
+/// HighlightMatch::applicableActions() is called.
+QList<HighlightMatch> Action::highlight(const QString& text, const HighlightOptions& options,
+                                        bool *truncated)
+{
+    const QSharedPointer<const HighlightScanner> scanner = highlightScanner(options.categories);
+    bool stopped;
+    const QList<HighlightMatch> result =
+        makeMatches(*scanner, findAll(*scanner, text, options, &stopped),
+                    MatchTemplate(text, QStringList()));
+    if (truncated)
+        *truncated = stopped;
+    return result;
+}
+
+/// Highlights fragments of the UTF-8 \a text like highlight(const
+/// QString&, const HighlightOptions&, bool*) with the default options.  The
+/// start and end of the matches are byte offsets into \a text; if \a utf16
+/// is given, it gets the (start, length) of each match in UTF-16 code units,
+/// as in the QString of the text.  When the built-in highlighter rules are
+/// in use, the text is scanned as it is, without converting it to UTF-16.
+/// Invalid UTF-8 sequences are treated as U+FFFD characters.
+QList<HighlightMatch> Action::highlightUtf8(const QByteArray& text,
+                                           QList<QPair<int, int> > *utf16)
+{
+    const QSharedPointer<const HighlightScanner> scanner = highlightScanner();
+    const QVector<Highlight> highlights = findAllUtf8(*scanner, text);
+    if (utf16)
+        *utf16 = utf16Offsets(text, highlights);
+    return makeMatches(*scanner, highlights, MatchTemplate(text, QStringList()));
+}
+
+MatchTemplate::MatchTemplate(const QString& text, const QStringList& mimeTypes)
+    : text(text), isUtf8(false), mimeTypes(mimeTypes), resolved(false)
+{
+}
+
+MatchTemplate::MatchTemplate(const QByteArray& utf8, const QStringList& mimeTypes)
+    : utf8(utf8), isUtf8(true), mimeTypes(mimeTypes), resolved(false)
+{
+}
+
+QString MatchTemplate::fragment(int start, int end) const
+{
+    if (isUtf8)
+        return QString::fromUtf8(utf8.constData() + start, end - start);
+    return text.mid(start, end - start);
+}
+
+void MatchTemplate::attach(HighlightMatch *match, const QSharedPointer<MatchTemplate>& t)
+{
+    match->d = t;
+}
+
+// Returns the desktop files of the actions for the category, looking them up
+// on the first call.
+const QStringList& MatchTemplate::desktopFiles() const
+{
+    if (!resolved) {
+        desktops = desktopFilesFor(mimeTypes);
+        resolved = true;
+    }
+    return desktops;
+}
+
+// Returns the desktop files of the handlers of \a mimeTypes, without
+// duplicates.
+QStringList Internal::desktopFilesFor(const QStringList& mimeTypes)
+{
+    QStringList desktops;
+    Q_FOREACH (const QString& mimeType, mimeTypes) {
+        Q_FOREACH (const QString& app, appsForContentType(mimeType)) {
+            const QString &desktop = findDesktopFile(app);
+            if (desktop != "" && !desktops.contains(desktop))
+                desktops << desktop;
         }
     }
+    return desktops;
+}
+
+/// Returns the actions applicable to the matched fragment.  They are created
+/// on each call; the handlers of the category are looked up only once for
+/// all the matches returned by the same Action::highlight() call.
+QList<Action> HighlightMatch::applicableActions() const
+{
+    QList<Action> result;
+    if (!d)
+        return result;
+    const QString fragment = d->fragment(start, end);
+    Q_FOREACH (const QString& desktop, d->desktopFiles())
+        result << createAction(desktop, QStringList() << fragment);
     return result;
 }
 
@@ -69,40 +789,110 @@ bool Match::operator<(const Match& other) const
             || ((this->start == other.start) && (this->end < other.end));
 }
 
+bool HighlightMatch::operator<(const HighlightMatch& other) const
+{
+    return (this->start < other.start)
+            || ((this->start == other.start) && (this->end < other.end));
+}
+
 /// Finds fragments of \a text which have applicable actions.  Returns a list of
 /// (start, length) pairs which identify the locations of the fragments.  The
 /// fragments can be passed to ContentAction::Action::actionsForString() and
 /// ContentAction::Action::defaultActionForString() for finding out the
-/// applicable actions and the default action.
+/// applicable actions and the default action.  The regexps are run only
+/// around the characters which every match of some category must contain;
+/// the rest of the text is skipped.
 QList<QPair<int, int> > Action::findHighlights(const QString& text)
 {
-    QRegularExpression regexp = masterRegexp();
+    return findHighlights(text, HighlightOptions());
+}
 
+/// Finds fragments of the UTF-8 \a text like findHighlights(const
+/// QString&).  Returns the (start, length) of each fragment in bytes, and if
+/// \a utf16 is given, sets it to the same in UTF-16 code units.  The text is
+/// scanned like by highlightUtf8().
+QList<QPair<int, int> > Action::findHighlightsUtf8(const QByteArray& text,
+                                                  QList<QPair<int, int> > *utf16)
+{
+    const QVector<Highlight> highlights = findAllUtf8(*highlightScanner(), text);
+    if (utf16)
+        *utf16 = utf16Offsets(text, highlights);
     QList<QPair<int, int> > result;
+    Q_FOREACH (const Highlight& h, highlights)
+        result << QPair<int, int>{h.start, h.length};
+    return result;
+}
 
-    if (regexp.pattern() == "(?:)") {
-        // The regexp doesn't have any real content -> no matches. "(?:)" is
-        // what masterRegexp() will return if there are no regexps to combine
-        // together.
-        return result;
-    }
-
-    QPair<int, int> next;
-    int pos = 0;
-    while (true) {
-        next = findNextHighlight(text, pos);
-        if (next.first == -1)
-            break;
-
-        result << QPair<int, int>{next.first, next.second};
+/// Finds fragments of \a text like findHighlights(const QString&), with the
+/// given \a options.  With a thread pool, a large text is split at whitespace
+/// into chunks which are scanned concurrently.  The result is the same as
+/// with the sequential scan, as long as the matches are shorter than 4096
+/// characters.
+///
+/// If the timeout of \a options runs out or its cancel flag is set, the scan
+/// stops and the result has the fragments found before that point of the
+/// text; \a truncated, if given, tells whether this happened.  The budget is
+/// checked between matches, and between the stretches of text the
+/// highlighter regexps are run on.  Where the categories have priorities,
+/// the fragments are selected among the matches found before that point, so
+/// a fragment may be kept which a match after it would have pushed out.
+///
+/// If the categories of \a options are given, only those of the highlighter
+/// mimetypes are matched, with a matcher compiled for them which is kept for
+/// the next calls with the same categories.  A category whose special cases
+/// are left out then matches also what they would have matched.
+///
+/// Where matches of categories overlap, the one of the category with the
+/// higher priority is kept; at the same priority the one which starts first,
+/// and at the same start the special case.  If the keepOverlaps flag of \a
+/// options is set, all the matches of each category are returned instead,
+/// ordered by their start, and those results are not cached.  Keeping the
+/// overlaps, or sorting them out by priority, takes a pass over the text for
+/// each category instead of a single one.
+QList<QPair<int, int> > Action::findHighlights(const QString& text,
+                                              const HighlightOptions& options,
+                                              bool *truncated)
+{
+    QList<QPair<int, int> > result;
+    bool stopped;
+    const QVector<Highlight> highlights =
+        findAll(*highlightScanner(options.categories), text, options, &stopped);
+    Q_FOREACH (const Highlight& h, highlights)
+        result << QPair<int, int>{h.start, h.length};
+    if (truncated)
+        *truncated = stopped;
+    return result;
+}
 
-        pos = next.first + next.second;
-        if (next.second == 0)
-            // regexp matched an empty string, avoid the inifinite loop
-            ++pos;
-    }
+/// Finds the fragments of each of \a texts like findHighlights(const
+/// QString&, const HighlightOptions&, bool*), in one call which sets up the
+/// scan only once.  The matches are returned in flat arrays, in the order of
+/// the texts and the matches in them.  With a thread pool, a large batch is
+/// split into runs of texts which are scanned concurrently.  If the scan
+/// stops early, the result has the matches up to that point and \a
+/// truncated, if given, is set to true.  The highlight cache is not used.
+HighlightBatch Action::findHighlights(const QStringList& texts,
+                                     const HighlightOptions& options,
+                                     bool *truncated)
+{
+    const QSharedPointer<const HighlightScanner> scanner = highlightScanner(options.categories);
+    HighlightBatch batch;
+    batch.categories = scanner->categories;
+    HighlightBudget budget(options);
 
-    return result;
+    int totalLength = 0;
+    Q_FOREACH (const QString& text, texts)
+        totalLength += text.length();
+    bool complete;
+    if (options.threadPool && texts.size() > 1 && totalLength >= 2 * MinParallelChunk)
+        complete = scanBatchInParallel(*scanner, texts, totalLength, options.threadPool,
+                                       &budget, options.keepOverlaps, &batch);
+    else
+        complete = scanBatch(*scanner, texts, 0, texts.size(), &budget,
+                             options.keepOverlaps, &batch);
+    if (truncated)
+        *truncated = !complete;
+    return batch;
 }
 
 /// Finds the next fragment of \a text, starting from \a start, which has
@@ -111,23 +901,80 @@ QList<QPair<int, int> > Action::findHighlights(const QString& text)
 /// found.  The fragment can be passed to
 /// ContentAction::Action::actionsForString() and
 /// ContentAction::Action::defaultActionForString() for finding out the
-/// applicable actions and the default action.
+/// applicable actions and the default action.  The fragment is the next one
+/// a single pass over the text finds, so the priorities of the categories
+/// are not taken into account.
 QPair<int, int> Action::findNextHighlight(const QString& text, int start)
 {
-    QRegularExpression regexp = masterRegexp();
-
-    if (regexp.pattern() == "(?:)") {
-        // The regexp doesn't have any real content -> no matches. "(?:)" is
-        // what masterRegexp() will return if there are no regexps to combine
-        // together.
+    int matchStart, matchLength;
+    if (highlightScanner()->next(text, start, &matchStart, &matchLength) == -1)
         return qMakePair<int, int>(-1, -1);
-    }
-    QRegularExpressionMatch match = regexp.match(text, start);
-    if (!match.hasMatch()) {
+
+    return qMakePair(matchStart, matchLength);
+}
+
+/// Finds the next fragment of \a text like findNextHighlight(const QString&,
+/// int), of the categories of \a options if given, but gives up when the
+/// timeout of \a options runs out or its cancel flag is set.  Then (-1, -1)
+/// is returned and \a truncated, if given, is set to true.
+QPair<int, int> Action::findNextHighlight(const QString& text, int start,
+                                          const HighlightOptions& options,
+                                          bool *truncated)
+{
+    const QSharedPointer<const HighlightScanner> scanner = highlightScanner(options.categories);
+    HighlightBudget budget(options);
+    HighlightCursor cursor(*scanner, text, start, &budget);
+    int matchStart, matchLength;
+    int category = cursor.next(&matchStart, &matchLength);
+    if (truncated)
+        *truncated = cursor.isTruncated();
+    if (category == -1)
         return qMakePair<int, int>(-1, -1);
+
+    return qMakePair(matchStart, matchLength);
+}
+
+/// Returns the engine which matches each of the highlighter categories in
+/// use.  The built-in categories are matched by scanners generated when the
+/// library was built, and the others by an automaton which takes linear
+/// time.  Only regexps the automaton does not support, like ones with
+/// backreferences, are left to PCRE, which gives up on a text when matching
+/// it takes too much backtracking.
+QMap<QString, HighlightEngine> highlightEngines()
+{
+    const QSharedPointer<const HighlightScanner> scanner = highlightScanner();
+    QMap<QString, HighlightEngine> engines;
+    Q_FOREACH (const QSharedPointer<const HighlightBackend>& backend, scanner->backends) {
+        Q_FOREACH (int category, backend->categories())
+            engines.insert(scanner->categories[category], backend->engine());
     }
+    return engines;
+}
 
-    return qMakePair(match.capturedStart(), match.capturedLength());
+/// Makes Action::highlight() and Action::findHighlights() keep the matches
+/// of the last \a entries texts, so that highlighting one of them again
+/// returns the same matches without scanning it.  Only complete results are
+/// kept.  The default is 0, which disables the cache; setting a smaller size
+/// drops the least recently used texts.  The size is a number of texts, not
+/// of bytes: each entry keeps its text, shared with the QString it was
+/// highlighted from, and its matches, so the memory used grows with the
+/// length of the texts.
+void setHighlightCacheSize(int entries)
+{
+    HighlightCache *cache = highlightCache();
+    QMutexLocker locker(&cache->mutex);
+    cache->entries.setMaxCost(qMax(0, entries));
+}
+
+/// Returns how many calls the highlight cache has answered, how many had to
+/// scan the text, and how many texts it holds.
+HighlightCacheStatistics highlightCacheStatistics()
+{
+    HighlightCache *cache = highlightCache();
+    QMutexLocker locker(&cache->mutex);
+    HighlightCacheStatistics stats = cache->stats;
+    stats.entries = cache->entries.size();
+    return stats;
 }
 
 } // end namespace
@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+#include "contentaction.h"
+#include "internal.h"
+#include "highlight.h"
+
+#include <QHash>
+#include <QIODevice>
+#include <QTextStream>
+#include <QVector>
+
+namespace ContentAction {
+
+using namespace ContentAction::Internal;
+
+namespace {
+
+// How much text is decoded from the device at a time.
+const int ChunkSize = 64 * 1024;
+
+} // end anon namespace
+
+struct HighlightReader::Private
+{
+    Private(QIODevice *device, int overlap)
+        : stream(device), overlap(qMax(1, overlap)), bufferStart(0), pos(0),
+          category(-1), scanner(highlightScanner()), selectedValid(false), nextSelected(0)
+    {
+    }
+
+    bool fill();
+    int next(int *matchStart, int *matchLength);
+
+    QTextStream stream;
+    int overlap;
+    // the text read but not yet scanned, after some already scanned text
+    // which is kept as context
+    QString buffer;
+    // position of buffer in the whole text
+    qint64 bufferStart;
+    // where scanning continues in buffer
+    int pos;
+    // category and fragment of the last match
+    int category;
+    QString fragment;
+    // category -> desktop files of its handlers
+    QHash<int, QStringList> desktops;
+    // the scanner of the whole text, even if the highlighter configuration
+    // is reloaded meanwhile
+    QSharedPointer<const HighlightScanner> scanner;
+    // if the categories have priorities: the matches selected in buffer
+    // from pos, until buffer changes, and the first one not returned yet
+    QVector<Highlight> selected;
+    bool selectedValid;
+    int nextSelected;
+};
+
+// Drops the text which is not needed anymore and reads the next chunk.
+// Returns false at the end of the device.
+bool HighlightReader::Private::fill()
+{
+    if (stream.atEnd())
+        return false;
+    // Keep some scanned text before pos as context for the regexps.
+    int drop = qMax(0, pos - overlap);
+    if (drop > 0) {
+        buffer.remove(0, drop);
+        bufferStart += drop;
+        pos -= drop;
+    }
+    buffer += stream.read(ChunkSize);
+    selectedValid = false;
+    return true;
+}
+
+// Finds the first match in buffer at or after pos, like
+// HighlightScanner::next().  If the categories have priorities, the matches
+// of the buffer are selected like in Action::findHighlights() once, and
+// returned one by one.
+int HighlightReader::Private::next(int *matchStart, int *matchLength)
+{
+    if (!scanner->hasPriorities())
+        return scanner->next(buffer, pos, matchStart, matchLength);
+
+    if (!selectedValid) {
+        selected = selectHighlights(*scanner, buffer, pos);
+        selectedValid = true;
+        nextSelected = 0;
+    }
+    while (nextSelected < selected.size() && selected[nextSelected].start < pos)
+        ++nextSelected;
+    if (nextSelected == selected.size())
+        return -1;
+    *matchStart = selected[nextSelected].start;
+    *matchLength = selected[nextSelected].length;
+    return selected[nextSelected].category;
+}
+
+/// \class ContentAction::HighlightReader
+/// Finds highlights in text read from a QIODevice, without reading all of it
+/// into memory.  The text is decoded and scanned in chunks.  The last
+/// \a overlap characters of a chunk are scanned again together with the next
+/// chunk, so a match is only cut at a chunk boundary if it is longer than
+/// the overlap.  The memory used depends on the overlap, not on the length of
+/// the text.  The matches are the same as the ones found by
+/// Action::findHighlights() for the whole text.  If the highlighter
+/// categories have priorities, the matches are selected among those found
+/// in the text read so far, so they differ only if a chain of overlapping
+/// matches is longer than the overlap.  The reader keeps using the
+/// highlighter rules which were in use when it was constructed.
+
+/// Constructs a reader for the text on \a device, which must be open.  The
+/// device is not owned by the reader.
+HighlightReader::HighlightReader(QIODevice *device, int overlap)
+    : priv(new Private(device, overlap))
+{
+}
+
+HighlightReader::~HighlightReader()
+{
+    delete priv;
+}
+
+/// Reads until the next match.  Returns false at the end of the text.
+/// Otherwise sets \a start to the position of the match in the whole text,
+/// \a text to the matching fragment and \a category to the highlighter
+/// mimetype which matched.  Any of them may be null.
+bool HighlightReader::readNext(qint64 *start, QString *text, QString *category)
+{
+    const HighlightScanner& scanner = *priv->scanner;
+    if (scanner.isEmpty())
+        return false;
+
+    while (true) {
+        bool atEnd = priv->stream.atEnd();
+        if (!atEnd && priv->buffer.length() - priv->pos < ChunkSize + priv->overlap) {
+            priv->fill();
+            continue;
+        }
+
+        int matchStart, matchLength;
+        int found = priv->next(&matchStart, &matchLength);
+
+        // A match too close to the end of the buffer might continue in the
+        // text not read yet.
+        if (!atEnd && (found == -1 || matchStart >= priv->buffer.length() - priv->overlap)) {
+            priv->pos = qMax(priv->pos, priv->buffer.length() - priv->overlap);
+            priv->fill();
+            continue;
+        }
+        if (found == -1) {
+            priv->category = -1;
+            return false;
+        }
+
+        priv->category = found;
+        priv->fragment = priv->buffer.mid(matchStart, matchLength);
+        if (start)
+            *start = priv->bufferStart + matchStart;
+        if (text)
+            *text = priv->fragment;
+        if (category)
+            *category = scanner.categories[found];
+
+        priv->pos = matchStart + matchLength;
+        if (matchLength == 0)
+            // regexp matched an empty string, avoid the inifinite loop
+            ++priv->pos;
+        return true;
+    }
+}
+
+/// Returns the actions applicable to the fragment found by the last
+/// readNext().  The handlers of a category are looked up only once.
+QList<Action> HighlightReader::actions() const
+{
+    QList<Action> result;
+    if (priv->category == -1)
+        return result;
+    QHash<int, QStringList>::iterator it = priv->desktops.find(priv->category);
+    if (it == priv->desktops.end()) {
+        it = priv->desktops.insert(
+            priv->category,
+            desktopFilesFor(priv->scanner->mimeTypes[priv->category]));
+    }
+    Q_FOREACH (const QString& desktop, it.value())
+        result << createAction(desktop, QStringList() << priv->fragment);
+    return result;
+}
+
+} // end namespace ContentAction
@@ -9,6 +9,8 @@
 #include <QPair>
 #include <QStringList>
 #include <QDebug>
+#include <QDBusMessage>
+#include <QFile>
 
 #include <gio/gdesktopappinfo.h>
 
@@ -25,6 +27,7 @@ struct ActionPrivate
     virtual QString name() const;
     virtual QString localizedName() const;
     virtual QString icon() const;
+    virtual QString launchKey() const;
     virtual void trigger(bool wait) const;
 };
 
@@ -38,6 +41,7 @@ struct DefaultPrivate : public ActionPrivate
     virtual QString name() const;
     virtual QString localizedName() const;
     virtual QString icon() const;
+    virtual QString launchKey() const;
     QSharedPointer<MDesktopEntry> desktopEntry;
     QStringList params;
     bool valid;
@@ -55,12 +59,14 @@ struct DBusPrivate : public DefaultPrivate {
     DBusPrivate(QSharedPointer<MDesktopEntry> desktopEntry,
                 const QStringList& params);
     virtual void trigger(bool) const;
+    void buildMessage();
 
     QString busName;
     QString objectPath;
     QString iface;
     QString method;
     bool varArgs;
+    QDBusMessage message;
 };
 
 struct ExecPrivate : public DefaultPrivate {
@@ -68,10 +74,20 @@ struct ExecPrivate : public DefaultPrivate {
                 const QStringList& params);
     virtual ~ExecPrivate();
     virtual void trigger(bool) const;
+    static void launch(GDesktopAppInfo *appInfo, const QStringList& params);
 
     GDesktopAppInfo *appInfo;
 };
 
+struct ActivatablePrivate : public ExecPrivate {
+    ActivatablePrivate(QSharedPointer<MDesktopEntry> desktopEntry,
+                       const QStringList& params);
+    virtual void trigger(bool) const;
+
+    QString busName;
+    QString objectPath;
+};
+
 Action createAction(const QString& desktopFilePath,
                     const QStringList& params);
 Action createAction(QSharedPointer<MDesktopEntry> desktopEntry,
@@ -83,6 +99,18 @@ extern const QString UriSchemeMimeClass;
 
 namespace Internal {
 
+// Held for as long as a launch is in progress; releasing the last reference
+// lets the next queued launch start.
+class LaunchSlot
+{
+public:
+    LaunchSlot();
+    ~LaunchSlot();
+private:
+    Q_DISABLE_COPY(LaunchSlot)
+};
+typedef QSharedPointer<LaunchSlot> LaunchSlotRef;
+
 // custom .desktop file keys
 extern const QString XMaemoServiceKey;
 extern const QString XOssoServiceKey;
@@ -90,19 +118,42 @@ extern const QString XMaemoMethodKey;
 extern const QString XMaemoObjectPathKey;
 extern const QString XMaemoFixedArgsKey;
 extern const QString ExecKey;
+extern const QString DBusActivatableKey;
 
 QList<Action> actionsForUri(const QString& uri, const QString& mimeType);
 QList<Action> actionsForUris(const QStringList& uri, const QString& mimeType);
 LCA_EXPORT QStringList appsForContentType(const QString& contentType);
 LCA_EXPORT QString defaultAppForContentType(const QString& contentType);
 QString findDesktopFile(const QString& id);
+bool admitLaunch(const QString& key);
+bool scheduleLaunch(const QSharedPointer<ActionPrivate>& action,
+                    const QString& key, LaunchPriority priority);
+void runLaunch(const QSharedPointer<ActionPrivate>& action);
+LaunchSlotRef currentLaunchSlot();
+void readKeyValues(QFile& file, QHash<QString, QString>& dict);
 
 LCA_EXPORT QString mimeForScheme(const QString& uri);
 LCA_EXPORT QString mimeForFile(const QUrl& fileUri);
 LCA_EXPORT QStringList mimeForString(const QString& param);
 
-const QHash<QString, QStringList>& mimeApps();
-const QList<QPair<QString, QRegularExpression> >& highlighterConfig();
+QHash<QString, QStringList> mimeApps();
+QStringList mimeAssociationDirs();
+// The highlighter rules of the configuration files
+struct HighlighterConfig
+{
+    // (mimetype, regexp), the special cases before the general cases
+    QList<QPair<QString, QRegularExpression> > rules;
+    // mimetype -> the mimetype it is a special case of
+    QHash<QString, QString> parents;
+    // mimetype -> its priority, if it was given
+    QHash<QString, int> priorities;
+};
+
+QString highlighterConfigPath();
+HighlighterConfig currentHighlighterConfig();
+HighlighterConfig reloadHighlighterConfig();
+QList<QPair<QString, QRegularExpression> > highlighterConfig();
+QHash<QString, QString> highlighterParents();
 QRegularExpression masterRegexp();
 
 
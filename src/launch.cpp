@@ -0,0 +1,331 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "internal.h"
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QQueue>
+#include <QThreadStorage>
+
+namespace ContentAction {
+
+using namespace ContentAction::Internal;
+
+namespace {
+
+// Double taps and re-entrant UI code tend to trigger the same action a few
+// times within a couple of hundred milliseconds.
+const int DefaultDuplicateWindow = 500;
+
+// Don't bother pruning the recently launched keys before there are this many.
+const int PruneThreshold = 32;
+
+// How many launches may be in flight at once, and how many more may wait for
+// their turn before new ones are refused.
+const int DefaultConcurrency = 4;
+const int DefaultQueueLimit = 64;
+
+struct QueuedLaunch
+{
+    QSharedPointer<ActionPrivate> action;
+    QString key;
+};
+
+struct Launcher
+{
+    Launcher()
+        : window(DefaultDuplicateWindow),
+          concurrency(DefaultConcurrency),
+          queueLimit(DefaultQueueLimit),
+          running(0),
+          draining(false)
+    {
+        clock.start();
+        stats.launched = 0;
+        stats.suppressed = 0;
+        stats.running = 0;
+        stats.queued = 0;
+        stats.peakQueued = 0;
+        stats.rejected = 0;
+    }
+
+    void prune(qint64 now)
+    {
+        QHash<QString, qint64>::iterator it = recent.begin();
+        while (it != recent.end()) {
+            if (now - it.value() >= window)
+                it = recent.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    int queued() const
+    {
+        return userQueue.size() + backgroundQueue.size();
+    }
+
+    QMutex mutex;
+    QElapsedTimer clock;
+    // trigger key -> time of the launch
+    QHash<QString, qint64> recent;
+    int window;
+
+    int concurrency;
+    int queueLimit;
+    int running;
+    bool draining;
+    QQueue<QueuedLaunch> userQueue;
+    QQueue<QueuedLaunch> backgroundQueue;
+
+    LaunchStatistics stats;
+};
+
+Q_GLOBAL_STATIC(Launcher, launcher)
+Q_GLOBAL_STATIC(QThreadStorage<LaunchSlotRef>, currentSlot)
+
+void drain();
+
+// Triggers the action.  The launch keeps its slot for as long as somebody
+// holds a reference to it: synchronous backends are done when trigger()
+// returns, asynchronous ones take a reference with currentLaunchSlot() and
+// drop it when the reply arrives.
+void start(const QSharedPointer<ActionPrivate>& action, bool wait)
+{
+    LaunchSlotRef previous = currentSlot()->localData();
+    {
+        LaunchSlotRef slot(new LaunchSlot);
+        currentSlot()->setLocalData(slot);
+        action->trigger(wait);
+    }
+    currentSlot()->setLocalData(previous);
+}
+
+// Starts queued launches, user initiated ones first, while there are free
+// slots.
+void drain()
+{
+    Launcher *l = launcher();
+    QMutexLocker locker(&l->mutex);
+
+    // Finishing a launch synchronously inside start() ends up here again;
+    // the outer loop takes care of it.
+    if (l->draining)
+        return;
+    l->draining = true;
+    while (l->running < l->concurrency) {
+        QueuedLaunch next;
+        if (!l->userQueue.isEmpty())
+            next = l->userQueue.dequeue();
+        else if (!l->backgroundQueue.isEmpty())
+            next = l->backgroundQueue.dequeue();
+        else
+            break;
+        ++l->running;
+        ++l->stats.launched;
+        locker.unlock();
+        start(next.action, false);
+        locker.relock();
+    }
+    l->draining = false;
+}
+
+} // end anon namespace
+
+namespace Internal {
+
+LaunchSlot::LaunchSlot()
+{
+}
+
+LaunchSlot::~LaunchSlot()
+{
+    // A reply may still be pending when the process exits.
+    if (launcher.isDestroyed())
+        return;
+    Launcher *l = launcher();
+    {
+        QMutexLocker locker(&l->mutex);
+        --l->running;
+    }
+    drain();
+}
+
+// Returns true if a trigger identified by \a key should result in a launch.
+// Returns false if the same handler was launched with the same parameters
+// less than the duplicate window ago.  Triggers with an empty key are always
+// let through.
+bool admitLaunch(const QString& key)
+{
+    if (key.isEmpty())
+        return true;
+
+    Launcher *l = launcher();
+    QMutexLocker locker(&l->mutex);
+
+    if (l->window > 0) {
+        qint64 now = l->clock.elapsed();
+        QHash<QString, qint64>::const_iterator it = l->recent.constFind(key);
+        if (it != l->recent.constEnd() && now - it.value() < l->window) {
+            ++l->stats.suppressed;
+            return false;
+        }
+        if (l->recent.size() >= PruneThreshold)
+            l->prune(now);
+        l->recent.insert(key, now);
+    }
+    return true;
+}
+
+// Launches \a action now if there is a free slot, otherwise queues it
+// according to its \a priority.  Returns false if the queue is full and the
+// launch was refused.  Only background launches are refused: a user
+// initiated launch pushes out the newest queued background launch, or if
+// there is none it is queued over the limit.  A user launch which has been
+// accepted is never dropped.
+bool scheduleLaunch(const QSharedPointer<ActionPrivate>& action,
+                    const QString& key, LaunchPriority priority)
+{
+    Launcher *l = launcher();
+    QMutexLocker locker(&l->mutex);
+
+    if (l->running < l->concurrency && l->queued() == 0) {
+        ++l->running;
+        ++l->stats.launched;
+        locker.unlock();
+        start(action, false);
+        return true;
+    }
+
+    if (l->queued() >= l->queueLimit) {
+        if (priority == BackgroundLaunch) {
+            LCA_WARNING << "launch queue is full, refusing a background launch";
+            l->recent.remove(key);
+            ++l->stats.rejected;
+            return false;
+        }
+        if (!l->backgroundQueue.isEmpty()) {
+            QueuedLaunch dropped = l->backgroundQueue.takeLast();
+            LCA_WARNING << "launch queue is full, dropping a queued background launch";
+            l->recent.remove(dropped.key);
+            ++l->stats.rejected;
+        }
+    }
+
+    QueuedLaunch launch = { action, key };
+    if (priority == UserLaunch)
+        l->userQueue.enqueue(launch);
+    else
+        l->backgroundQueue.enqueue(launch);
+    l->stats.peakQueued = qMax(l->stats.peakQueued, l->queued());
+    return true;
+}
+
+// Launches \a action right away and waits for it.  The caller is blocked
+// anyway, so it doesn't make sense to queue it, but it still occupies a slot
+// while it runs.
+void runLaunch(const QSharedPointer<ActionPrivate>& action)
+{
+    Launcher *l = launcher();
+    {
+        QMutexLocker locker(&l->mutex);
+        ++l->running;
+        ++l->stats.launched;
+    }
+    start(action, true);
+}
+
+// Returns the slot of the launch being started by this thread.  Backends
+// which complete asynchronously keep it until they are done.
+LaunchSlotRef currentLaunchSlot()
+{
+    return currentSlot()->localData();
+}
+
+} // end namespace Internal
+
+/// Sets the window, in milliseconds, during which repeated triggers of an
+/// action with the same handler and parameters are collapsed into the first
+/// one.  Zero disables the deduplication.  The default is 500 ms.
+void setDuplicateTriggerWindow(int msecs)
+{
+    Launcher *l = launcher();
+    QMutexLocker locker(&l->mutex);
+    l->window = qMax(0, msecs);
+    l->recent.clear();
+}
+
+/// Sets how many launches may be in progress at the same time.  Further
+/// triggers wait in a queue until a launch completes.  A D-Bus launch is in
+/// progress until the application replies.  The default is 4.
+void setLaunchConcurrency(int maxRunning)
+{
+    Launcher *l = launcher();
+    {
+        QMutexLocker locker(&l->mutex);
+        l->concurrency = qMax(1, maxRunning);
+    }
+    drain();
+}
+
+/// Returns how many launches may be in progress at the same time.
+int launchConcurrency()
+{
+    Launcher *l = launcher();
+    QMutexLocker locker(&l->mutex);
+    return l->concurrency;
+}
+
+/// Sets how many launches may wait in the queue.  When the queue is full,
+/// Action::trigger(LaunchPriority) refuses background launches and returns
+/// false.  A user initiated launch is never refused; it takes the place of a
+/// queued background launch, or if there is none the queue grows past the
+/// limit.  The user launches in the queue are never dropped.  The default is
+/// 64.
+void setLaunchQueueLimit(int maxQueued)
+{
+    Launcher *l = launcher();
+    QMutexLocker locker(&l->mutex);
+    l->queueLimit = qMax(0, maxQueued);
+}
+
+/// Returns how many launches may wait in the queue.
+int launchQueueLimit()
+{
+    Launcher *l = launcher();
+    QMutexLocker locker(&l->mutex);
+    return l->queueLimit;
+}
+
+/// Returns the counters of launches issued and duplicate launches avoided by
+/// this process, and the current state of the launch queue.
+LaunchStatistics launchStatistics()
+{
+    Launcher *l = launcher();
+    QMutexLocker locker(&l->mutex);
+    LaunchStatistics stats = l->stats;
+    stats.running = l->running;
+    stats.queued = l->queued();
+    return stats;
+}
+
+} // end namespace ContentAction
@@ -37,6 +37,8 @@
 #include <QDebug>
 #include <QFile>
 #include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
 #include <QDBusInterface>
 #include <QDBusPendingCall>
 #include <QRegularExpression>
@@ -48,17 +50,8 @@
 #define endl Qt::endl;
 #endif
 
-namespace { // Helper functions
-
-bool readLastModifiedTime(const QString& filename, long& time)
-{
-    struct stat statData;
-    if (stat(filename.toLatin1().constData(), &statData) == 0) {
-        time = statData.st_mtim.tv_sec * 1000 + statData.st_mtim.tv_nsec / 1000000;
-        return true;
-    }
-    return false;
-}
+namespace ContentAction {
+namespace Internal {
 
 // Reads "Key=Value" formatted lines from the file, and updates dict with
 // them.
@@ -82,12 +75,39 @@ void readKeyValues(QFile& file, QHash<QString, QString>& dict)
     file.close();
 }
 
+} // end namespace Internal
+} // end namespace ContentAction
 
-QHash<QString, QString> readChangedKeyValueFiles(const QStringList& dirs,
-                                                 const QStringList& suffixes)
+namespace { // Helper functions
+
+using ContentAction::Internal::readKeyValues;
+
+bool readLastModifiedTime(const QString& filename, long& time)
 {
-    // Read each file if it has changed since the last time we read it.
+    struct stat statData;
+    if (stat(filename.toLatin1().constData(), &statData) == 0) {
+        time = statData.st_mtim.tv_sec * 1000 + statData.st_mtim.tv_nsec / 1000000;
+        return true;
+    }
+    return false;
+}
+
 
+
+// Guards the contents of the association files read below, which are also
+// read by the thread which rebuilds the highlighter.
+QMutex associationMutex;
+
+// Reads the files dirs[i] + suffixes[j] if any of them has changed since the
+// last time we read them, and sets changed to true.  In each dir, only the
+// first of the suffixes which exists is read.  The files are read in such an
+// order that the first ones override the later ones.  The result has all of
+// them, including the unchanged ones, so it replaces what was read before:
+// keys which were removed from the files are gone from it too.
+QHash<QString, QString> readChangedKeyValueFiles(const QStringList& dirs,
+                                                 const QStringList& suffixes,
+                                                 bool *changed)
+{
     // Using the "last modified" time for this purpose might be stupid, but what
     // else can we do.  Using a QFileSystemWatcher (or a similar solution) in a
     // library without a LifeTimeManager object is a bad idea too.  Deleting the
@@ -100,35 +120,35 @@ QHash<QString, QString> readChangedKeyValueFiles(const QStringList& dirs,
     // second change remains undetected by the reading process, until the file
     // is changed again.
 
-    // The "last modified" times of the files this function has read.
-    static QHash<QString, long> lastModified;
+    // The files read the last time for each list of suffixes, and their "last
+    // modified" times.  A file which appears or disappears is a change too.
+    static QHash<QString, QHash<QString, long> > lastModified;
 
-    QHash<QString, QString> temp;
-    // Whether a file has changed so that we need to re-read all the overriding
-    // files, too.
-    bool rereadAllThatFollows = false;
-    // Read the files in such a order that the first ones override the later
-    // ones.
+    QStringList filenames;
+    QHash<QString, long> modified;
     for (int i = dirs.size()-1; i >= 0; --i) {
         for (int suffix = 0; suffix < suffixes.size(); suffix++) {
             QString filename = dirs[i] + suffixes[suffix];
-            if (QFileInfo::exists(filename)) {
-                long lm = 0;
-                if (!readLastModifiedTime(filename, lm)) {
-                    // Most probably the file doesn't exist.
-                    continue;
-                }
-                if (!rereadAllThatFollows && lm == lastModified.value(filename)) {
-                    continue;
-                }
-                QFile f(filename);
-                readKeyValues(f, temp);
-                lastModified[filename] = lm;
-                rereadAllThatFollows = true;
+            long lm = 0;
+            // Most probably the file doesn't exist if the time can't be read.
+            if (QFileInfo::exists(filename) && readLastModifiedTime(filename, lm)) {
+                filenames << filename;
+                modified.insert(filename, lm);
                 break;
             }
         }
     }
+
+    QHash<QString, QString> temp;
+    QHash<QString, long>& previous = lastModified[suffixes.join(":")];
+    *changed = modified != previous;
+    if (!*changed)
+        return temp;
+    Q_FOREACH (const QString& filename, filenames) {
+        QFile f(filename);
+        readKeyValues(f, temp);
+    }
+    previous = modified;
     return temp;
 }
 
@@ -321,19 +341,16 @@ QString Internal::defaultAppForContentType(const QString& contentType)
 
     QStringList dirs = xdgDataDirs();
 
-    // Read the mimeapps.lists / defaults.lists which have changed since we
-    // read them the last time.
+    // Read the mimeapps.lists / defaults.lists again if they have changed
+    // since we read them the last time.
     QStringList files;
     files << "/applications/mimeapps.list";
     files << "/applications/defaults.list";
-    QHash<QString, QString> temp = readChangedKeyValueFiles(dirs, files);
-
-    // Merge the results into our cache
-    QHashIterator<QString, QString> it(temp);
-    while (it.hasNext()) {
-        it.next();
-        defaultApps.insert(it.key(), it.value());
-    }
+    QMutexLocker locker(&associationMutex);
+    bool changed;
+    QHash<QString, QString> temp = readChangedKeyValueFiles(dirs, files, &changed);
+    if (changed)
+        defaultApps = temp;
     if (defaultApps.contains(contentType))
         return defaultApps.value(contentType);
     QString generalizedType(generalizeMimeType(contentType));
@@ -342,22 +359,36 @@ QString Internal::defaultAppForContentType(const QString& contentType)
     return QString();
 }
 
+// Returns the directories of the files which tell the applications handling
+// each content type: mimeinfo.cache, mimeapps.list and defaults.list.
+QStringList Internal::mimeAssociationDirs()
+{
+    QStringList result;
+    Q_FOREACH (const QString& dir, xdgDataDirs())
+        result << dir + "/applications";
+    return result;
+}
+
 // Reads the mimeinfo.cache files and returns the mapping from mime types to
 // desktop entries. Tries to decide cleverly whether to re-read the files if
 // they might have changed.
-const QHash<QString, QStringList>& Internal::mimeApps()
+QHash<QString, QStringList> Internal::mimeApps()
 {
     static QHash<QString, QStringList> mimecache;
 
     QStringList dirs = xdgDataDirs();
 
-
-    // Read the mimeinfo.caches which have changed since we read them the last
-    // time.
+    // Read the mimeinfo.caches again if they have changed since we read them
+    // the last time.
+    QMutexLocker locker(&associationMutex);
+    bool changed;
     QHash<QString, QString> temp = readChangedKeyValueFiles(dirs,
-                                                            QStringList("/applications/mimeinfo.cache"));
+                                                            QStringList("/applications/mimeinfo.cache"),
+                                                            &changed);
+    if (!changed)
+        return mimecache;
 
-    // Merge the changes into our cache
+    mimecache.clear();
     QHashIterator<QString, QString> it(temp);
     while (it.hasNext()) {
         it.next();
@@ -378,14 +409,15 @@ const QHash<QString, QStringList>& Internal::mimeApps()
 QStringList Internal::appsForContentType(const QString& contentType)
 {
     QStringList ret;
+    const QHash<QString, QStringList> apps = mimeApps();
 
-    if (mimeApps().contains(contentType))
-        ret << mimeApps()[contentType];
+    if (apps.contains(contentType))
+        ret << apps[contentType];
 
     // Also add more general handlers.
     QString general(generalizeMimeType(contentType));
-    if (mimeApps().contains(general))
-        ret << mimeApps()[general];
+    if (apps.contains(general))
+        ret << apps[general];
 
     // Get the default app handling this content type, insert it to the front
     // of the list
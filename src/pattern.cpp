@@ -0,0 +1,714 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+#include "pattern.h"
+
+namespace ContentAction {
+namespace Internal {
+
+void CharSet::add(ushort first, ushort last)
+{
+    if (first > last)
+        return;
+    QVector<Range> merged;
+    merged.reserve(ranges.size() + 1);
+    bool inserted = false;
+    Q_FOREACH (const Range& r, ranges) {
+        if (uint(r.second) + 1 < first) {
+            merged << r;
+        } else if (uint(last) + 1 < r.first) {
+            if (!inserted) {
+                merged << Range(first, last);
+                inserted = true;
+            }
+            merged << r;
+        } else {
+            // overlapping or adjacent
+            first = qMin(first, r.first);
+            last = qMax(last, r.second);
+        }
+    }
+    if (!inserted)
+        merged << Range(first, last);
+    ranges = merged;
+}
+
+void CharSet::add(const CharSet& other)
+{
+    Q_FOREACH (const Range& r, other.ranges)
+        add(r.first, r.second);
+}
+
+CharSet CharSet::negated() const
+{
+    CharSet result;
+    uint next = 0;
+    Q_FOREACH (const Range& r, ranges) {
+        if (r.first > next)
+            result.ranges << Range(next, r.first - 1);
+        next = uint(r.second) + 1;
+    }
+    if (next <= 0xffff)
+        result.ranges << Range(next, 0xffff);
+    return result;
+}
+
+bool CharSet::contains(ushort c) const
+{
+    int lo = 0, hi = ranges.size() - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (c < ranges[mid].first)
+            hi = mid - 1;
+        else if (c > ranges[mid].second)
+            lo = mid + 1;
+        else
+            return true;
+    }
+    return false;
+}
+
+int CharSet::size() const
+{
+    int n = 0;
+    Q_FOREACH (const Range& r, ranges)
+        n += r.second - r.first + 1;
+    return n;
+}
+
+namespace {
+
+CharSet digits()
+{
+    CharSet set;
+    set.add('0', '9');
+    return set;
+}
+
+CharSet wordChars()
+{
+    CharSet set;
+    set.add('0', '9');
+    set.add('A', 'Z');
+    set.add('_');
+    set.add('a', 'z');
+    return set;
+}
+
+CharSet spaces()
+{
+    CharSet set;
+    set.add('\t', '\r');
+    set.add(' ');
+    return set;
+}
+
+class Parser
+{
+public:
+    Parser(const QString& pattern) : p(pattern), i(0), captures(0) {}
+
+    bool parseAlternation(PatternNode *node);
+    bool atEnd() const { return i >= p.length(); }
+
+    const QString& p;
+    int i;
+    int captures;
+
+private:
+    bool parseConcat(PatternNode *node);
+    bool parseRepeat(PatternNode *node);
+    bool parseAtom(PatternNode *node);
+    bool parseGroup(PatternNode *node);
+    bool parseClass(CharSet *set);
+    bool parseEscape(CharSet *set, bool inClass);
+    bool parseQuantifier(int *min, int *max);
+    bool parseNumber(int *n);
+    bool parseHex(ushort *c);
+};
+
+bool Parser::parseAlternation(PatternNode *node)
+{
+    PatternNode first;
+    if (!parseConcat(&first))
+        return false;
+    if (atEnd() || p[i] != '|') {
+        *node = first;
+        return true;
+    }
+    node->type = PatternNode::Alternation;
+    node->children << first;
+    while (!atEnd() && p[i] == '|') {
+        ++i;
+        PatternNode next;
+        if (!parseConcat(&next))
+            return false;
+        node->children << next;
+    }
+    return true;
+}
+
+bool Parser::parseConcat(PatternNode *node)
+{
+    node->type = PatternNode::Concat;
+    while (!atEnd() && p[i] != '|' && p[i] != ')') {
+        PatternNode child;
+        if (!parseRepeat(&child))
+            return false;
+        node->children << child;
+    }
+    if (node->children.isEmpty()) {
+        node->type = PatternNode::Empty;
+    } else if (node->children.size() == 1) {
+        PatternNode only = node->children.first();
+        *node = only;
+    }
+    return true;
+}
+
+bool Parser::parseRepeat(PatternNode *node)
+{
+    PatternNode atom;
+    if (!parseAtom(&atom))
+        return false;
+    while (!atEnd()) {
+        int min, max;
+        int at = i;
+        QChar c = p[i];
+        if (c == '*') {
+            min = 0; max = -1; ++i;
+        } else if (c == '+') {
+            min = 1; max = -1; ++i;
+        } else if (c == '?') {
+            min = 0; max = 1; ++i;
+        } else if (c == '{' && parseQuantifier(&min, &max)) {
+        } else {
+            i = at;
+            break;
+        }
+        PatternNode repeat;
+        repeat.type = PatternNode::Repeat;
+        repeat.min = min;
+        repeat.max = max;
+        if (!atEnd() && p[i] == '?') {
+            repeat.greedy = false;
+            ++i;
+        } else if (!atEnd() && p[i] == '+') {
+            // possessive
+            return false;
+        }
+        repeat.children << atom;
+        atom = repeat;
+    }
+    *node = atom;
+    return true;
+}
+
+bool Parser::parseNumber(int *n)
+{
+    int start = i;
+    *n = 0;
+    while (!atEnd() && p[i].isDigit() && p[i].unicode() < 128) {
+        *n = *n * 10 + (p[i].unicode() - '0');
+        if (*n > 65535)
+            return false;
+        ++i;
+    }
+    return i > start;
+}
+
+// {n}, {n,} or {n,m}; anything else is a literal '{'
+bool Parser::parseQuantifier(int *min, int *max)
+{
+    int start = i;
+    ++i;
+    if (!parseNumber(min)) {
+        i = start;
+        return false;
+    }
+    if (!atEnd() && p[i] == '}') {
+        ++i;
+        *max = *min;
+        return true;
+    }
+    if (atEnd() || p[i] != ',') {
+        i = start;
+        return false;
+    }
+    ++i;
+    if (!atEnd() && p[i] == '}') {
+        ++i;
+        *max = -1;
+        return true;
+    }
+    if (!parseNumber(max) || atEnd() || p[i] != '}' || *max < *min) {
+        i = start;
+        return false;
+    }
+    ++i;
+    return true;
+}
+
+bool Parser::parseAtom(PatternNode *node)
+{
+    QChar c = p[i];
+    switch (c.unicode()) {
+    case '(':
+        return parseGroup(node);
+    case '[':
+        ++i;
+        node->type = PatternNode::Chars;
+        return parseClass(&node->chars);
+    case '.':
+        ++i;
+        node->type = PatternNode::Chars;
+        node->chars.add('\n');
+        node->chars = node->chars.negated();
+        return true;
+    case '^':
+        ++i;
+        node->type = PatternNode::Start;
+        return true;
+    case '$':
+        ++i;
+        node->type = PatternNode::End;
+        return true;
+    case '*':
+    case '+':
+    case '?':
+        // nothing to repeat
+        return false;
+    case '\\':
+        ++i;
+        if (atEnd())
+            return false;
+        if (p[i] == 'b' || p[i] == 'B') {
+            node->type = p[i] == 'b' ? PatternNode::WordBoundary
+                                     : PatternNode::NotWordBoundary;
+            ++i;
+            return true;
+        }
+        node->type = PatternNode::Chars;
+        return parseEscape(&node->chars, false);
+    default:
+        ++i;
+        if (c.isHighSurrogate() && !atEnd() && p[i].isLowSurrogate()) {
+            // a character outside the BMP is a sequence of two code units
+            PatternNode high, low;
+            high.type = low.type = PatternNode::Chars;
+            high.chars.add(c.unicode());
+            low.chars.add(p[i].unicode());
+            ++i;
+            node->type = PatternNode::Group;
+            PatternNode pair;
+            pair.type = PatternNode::Concat;
+            pair.children << high << low;
+            node->children << pair;
+            return true;
+        }
+        node->type = PatternNode::Chars;
+        node->chars.add(c.unicode());
+        return true;
+    }
+}
+
+bool Parser::parseGroup(PatternNode *node)
+{
+    ++i;
+    node->type = PatternNode::Group;
+    if (!atEnd() && p[i] == '?') {
+        ++i;
+        if (atEnd())
+            return false;
+        QChar c = p[i];
+        if (c == ':') {
+            ++i;
+        } else if (c == '=') {
+            node->type = PatternNode::LookAhead;
+            ++i;
+        } else if (c == '!') {
+            node->type = PatternNode::NegLookAhead;
+            ++i;
+        } else if (c == '<' && i + 1 < p.length() && p[i + 1] == '=') {
+            node->type = PatternNode::LookBehind;
+            i += 2;
+        } else if (c == '<' && i + 1 < p.length() && p[i + 1] == '!') {
+            node->type = PatternNode::NegLookBehind;
+            i += 2;
+        } else if (c == '<' || c == 'P') {
+            // named group
+            if (c == 'P') {
+                ++i;
+                if (atEnd() || p[i] != '<')
+                    return false;
+            }
+            int close = p.indexOf('>', i);
+            if (close == -1)
+                return false;
+            i = close + 1;
+            node->capture = ++captures;
+        } else {
+            // inline options, comments, atomic groups, ...
+            return false;
+        }
+    } else {
+        node->capture = ++captures;
+    }
+    PatternNode child;
+    if (!parseAlternation(&child))
+        return false;
+    if (atEnd() || p[i] != ')')
+        return false;
+    ++i;
+    node->children << child;
+    return true;
+}
+
+bool Parser::parseHex(ushort *c)
+{
+    uint value = 0;
+    int digits = 0;
+    bool braces = !atEnd() && p[i] == '{';
+    if (braces)
+        ++i;
+    while (!atEnd() && (braces || digits < 2)) {
+        const ushort h = p[i].unicode();
+        int d;
+        if (h >= '0' && h <= '9')
+            d = h - '0';
+        else if (h >= 'a' && h <= 'f')
+            d = h - 'a' + 10;
+        else if (h >= 'A' && h <= 'F')
+            d = h - 'A' + 10;
+        else
+            break;
+        value = value * 16 + d;
+        if (value > 0xffff)
+            return false;
+        ++digits;
+        ++i;
+    }
+    if (braces) {
+        if (atEnd() || p[i] != '}')
+            return false;
+        ++i;
+    }
+    *c = value;
+    return true;
+}
+
+// Parses the escape after a backslash.
+bool Parser::parseEscape(CharSet *set, bool inClass)
+{
+    QChar c = p[i++];
+    switch (c.unicode()) {
+    case 'd': set->add(digits()); return true;
+    case 'D': set->add(digits().negated()); return true;
+    case 'w': set->add(wordChars()); return true;
+    case 'W': set->add(wordChars().negated()); return true;
+    case 's': set->add(spaces()); return true;
+    case 'S': set->add(spaces().negated()); return true;
+    case 'n': set->add('\n'); return true;
+    case 'r': set->add('\r'); return true;
+    case 't': set->add('\t'); return true;
+    case 'f': set->add('\f'); return true;
+    case 'v': set->add('\v'); return true;
+    case 'e': set->add(0x1b); return true;
+    case 'a': set->add(0x07); return true;
+    case 'x': {
+        ushort code;
+        if (!parseHex(&code))
+            return false;
+        set->add(code);
+        return true;
+    }
+    case 'b':
+        if (inClass) {
+            set->add(0x08);
+            return true;
+        }
+        return false;
+    default:
+        // backreferences, \p, \Q, ... are not supported; other escaped
+        // characters stand for themselves
+        if (c.isLetterOrNumber() || c.unicode() >= 128)
+            return false;
+        set->add(c.unicode());
+        return true;
+    }
+}
+
+bool Parser::parseClass(CharSet *set)
+{
+    bool negate = false;
+    if (!atEnd() && p[i] == '^') {
+        negate = true;
+        ++i;
+    }
+    CharSet chars;
+    bool first = true;
+    while (true) {
+        if (atEnd())
+            return false;
+        QChar c = p[i];
+        if (c == ']' && !first) {
+            ++i;
+            break;
+        }
+        first = false;
+        if (c == '[' && i + 1 < p.length() && (p[i + 1] == ':' || p[i + 1] == '.'
+                                              || p[i + 1] == '='))
+            // POSIX classes
+            return false;
+
+        ushort low;
+        CharSet escaped;
+        if (c == '\\') {
+            ++i;
+            if (atEnd() || !parseEscape(&escaped, true))
+                return false;
+            if (escaped.size() != 1) {
+                // \d, \w, ... can't start a range
+                chars.add(escaped);
+                continue;
+            }
+            low = escaped.toRanges().first().first;
+        } else {
+            if (c.isSurrogate())
+                return false;
+            low = c.unicode();
+            ++i;
+        }
+
+        if (i + 1 < p.length() && p[i] == '-' && p[i + 1] != ']') {
+            ++i;
+            ushort high;
+            if (p[i] == '\\') {
+                ++i;
+                CharSet end;
+                if (atEnd() || !parseEscape(&end, true) || end.size() != 1)
+                    return false;
+                high = end.toRanges().first().first;
+            } else {
+                if (p[i].isSurrogate())
+                    return false;
+                high = p[i].unicode();
+                ++i;
+            }
+            if (high < low)
+                return false;
+            chars.add(low, high);
+        } else {
+            chars.add(low);
+        }
+    }
+    set->add(negate ? chars.negated() : chars);
+    return true;
+}
+
+// How common a character is in ordinary text: sets of common characters
+// make poor anchors.
+int weight(uint c)
+{
+    if (c == ' ')
+        return 16;
+    if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))
+        return 8;
+    if ((c >= '0' && c <= '9') || c == '\n' || c == '\t')
+        return 4;
+    if (c == '.' || c == ',')
+        return 3;
+    if (c < 128)
+        return 1;
+    return 2;
+}
+
+int cost(const CharSet& set)
+{
+    int total = 0;
+    Q_FOREACH (const CharSet::Range& r, set.toRanges()) {
+        for (uint c = r.first; c <= r.second; ++c)
+            total += weight(c);
+    }
+    return total;
+}
+
+} // end anon namespace
+
+bool parsePattern(const QString& pattern, PatternNode *root, int *captures)
+{
+    Parser parser(pattern);
+    *root = PatternNode();
+    if (!parser.parseAlternation(root) || !parser.atEnd())
+        return false;
+    if (captures)
+        *captures = parser.captures;
+    return true;
+}
+
+CharSet consumableChars(const PatternNode& node)
+{
+    CharSet result;
+    switch (node.type) {
+    case PatternNode::Chars:
+        return node.chars;
+    case PatternNode::Concat:
+    case PatternNode::Alternation:
+    case PatternNode::Group:
+        Q_FOREACH (const PatternNode& child, node.children)
+            result.add(consumableChars(child));
+        return result;
+    case PatternNode::Repeat:
+        if (node.max != 0)
+            result = consumableChars(node.children.first());
+        return result;
+    default:
+        // lookarounds look at characters but don't consume them
+        return result;
+    }
+}
+
+bool requiredChars(const PatternNode& node, CharSet *result)
+{
+    switch (node.type) {
+    case PatternNode::Chars:
+        *result = node.chars;
+        return true;
+    case PatternNode::Group:
+        return requiredChars(node.children.first(), result);
+    case PatternNode::Repeat:
+        if (node.min == 0)
+            return false;
+        return requiredChars(node.children.first(), result);
+    case PatternNode::Concat: {
+        // Any of the required children will do; take the cheapest one.
+        bool found = false;
+        int best = 0;
+        Q_FOREACH (const PatternNode& child, node.children) {
+            CharSet set;
+            if (!requiredChars(child, &set))
+                continue;
+            int c = cost(set);
+            if (!found || c < best) {
+                *result = set;
+                best = c;
+                found = true;
+            }
+        }
+        return found;
+    }
+    case PatternNode::Alternation: {
+        CharSet all;
+        Q_FOREACH (const PatternNode& child, node.children) {
+            CharSet set;
+            if (!requiredChars(child, &set))
+                return false;
+            all.add(set);
+        }
+        *result = all;
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+int maximumLength(const PatternNode& node)
+{
+    switch (node.type) {
+    case PatternNode::Chars:
+        return 1;
+    case PatternNode::Concat: {
+        int total = 0;
+        Q_FOREACH (const PatternNode& child, node.children) {
+            int n = maximumLength(child);
+            if (n == -1)
+                return -1;
+            total += n;
+        }
+        return total;
+    }
+    case PatternNode::Alternation: {
+        int longest = 0;
+        Q_FOREACH (const PatternNode& child, node.children) {
+            int n = maximumLength(child);
+            if (n == -1)
+                return -1;
+            longest = qMax(longest, n);
+        }
+        return longest;
+    }
+    case PatternNode::Group:
+        return maximumLength(node.children.first());
+    case PatternNode::Repeat: {
+        if (node.max == 0)
+            return 0;
+        int n = maximumLength(node.children.first());
+        if (node.max == -1)
+            return n == 0 ? 0 : -1;
+        if (n == -1)
+            return -1;
+        return n * node.max;
+    }
+    default:
+        return 0;
+    }
+}
+
+int lookaroundLength(const PatternNode& node)
+{
+    switch (node.type) {
+    case PatternNode::WordBoundary:
+    case PatternNode::NotWordBoundary:
+        return 1;
+    case PatternNode::LookAhead:
+    case PatternNode::NegLookAhead:
+    case PatternNode::LookBehind:
+    case PatternNode::NegLookBehind: {
+        int inner = lookaroundLength(node.children.first());
+        int n = maximumLength(node.children.first());
+        if (inner == -1 || n == -1)
+            return -1;
+        return n + inner;
+    }
+    default: {
+        int longest = 0;
+        Q_FOREACH (const PatternNode& child, node.children) {
+            int n = lookaroundLength(child);
+            if (n == -1)
+                return -1;
+            longest = qMax(longest, n);
+        }
+        return longest;
+    }
+    }
+}
+
+bool isAnchored(const PatternNode& node)
+{
+    if (node.type == PatternNode::Start || node.type == PatternNode::End)
+        return true;
+    Q_FOREACH (const PatternNode& child, node.children) {
+        if (isAnchored(child))
+            return true;
+    }
+    return false;
+}
+
+} // end namespace Internal
+} // end namespace ContentAction
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef PATTERN_H
+#define PATTERN_H
+
+#include "contentaction.h"
+
+#include <QList>
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+namespace ContentAction {
+namespace Internal {
+
+// A set of UTF-16 code units, as sorted, disjoint, inclusive ranges.
+class LCA_EXPORT CharSet
+{
+public:
+    typedef QPair<ushort, ushort> Range;
+
+    void add(ushort c) { add(c, c); }
+    void add(ushort first, ushort last);
+    void add(const CharSet& other);
+    CharSet negated() const;
+    bool contains(ushort c) const;
+    bool isEmpty() const { return ranges.isEmpty(); }
+    int size() const;
+    const QVector<Range>& toRanges() const { return ranges; }
+
+    bool operator==(const CharSet& other) const { return ranges == other.ranges; }
+
+private:
+    QVector<Range> ranges;
+};
+
+// A node of a parsed regexp.
+struct PatternNode
+{
+    enum Type {
+        Empty,          // matches the empty string
+        Chars,          // one code unit out of chars
+        Concat,         // children one after another
+        Alternation,    // one of the children, the first one preferred
+        Repeat,         // children[0] min..max times, max -1 is unbounded
+        Group,          // children[0], captured if capture > 0
+        LookAhead,      // children[0] follows, without consuming it
+        NegLookAhead,
+        LookBehind,     // children[0] precedes the position
+        NegLookBehind,
+        WordBoundary,   // \b
+        NotWordBoundary,// \B
+        Start,          // ^
+        End             // $
+    };
+
+    PatternNode() : type(Empty), min(0), max(0), greedy(true), capture(0) {}
+
+    Type type;
+    CharSet chars;
+    QList<PatternNode> children;
+    int min, max;
+    bool greedy;
+    int capture;
+};
+
+// Parses the subset of the PCRE syntax used by highlighter regexps:
+// literals, escapes, character classes, groups, alternation, quantifiers,
+// lookarounds, \b and ^ $.  Returns false for anything else, like
+// backreferences, inline options and possessive quantifiers.
+LCA_EXPORT bool parsePattern(const QString& pattern, PatternNode *root, int *captures = 0);
+
+// Returns the code units which a match of node can consume.
+LCA_EXPORT CharSet consumableChars(const PatternNode& node);
+
+// Finds a set of code units at least one of which occurs in every match of
+// node, preferring sets of characters which are rare in ordinary text.
+// Returns false if there is no such set, for example if node can match the
+// empty string.
+LCA_EXPORT bool requiredChars(const PatternNode& node, CharSet *result);
+
+// Returns how far outside a match of node the lookarounds can look, or -1
+// if there is no limit.
+LCA_EXPORT int lookaroundLength(const PatternNode& node);
+
+// Returns the longest match of node, or -1 if there is no limit.
+LCA_EXPORT int maximumLength(const PatternNode& node);
+
+// Returns true if node contains ^ or $.
+LCA_EXPORT bool isAnchored(const PatternNode& node);
+
+} // end namespace Internal
+} // end namespace ContentAction
+
+#endif
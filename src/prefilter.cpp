@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+#include "prefilter.h"
+
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define LCA_NEON
+#endif
+
+namespace ContentAction {
+namespace Internal {
+
+namespace {
+
+// Regexps which look further than this around their matches are not
+// prefiltered.
+const int MaxLookaround = 16;
+
+// The vectorised search tests each range separately, so a set with more
+// ranges than this is searched with the table.
+const int MaxVectorRanges = 8;
+
+// Membership of all the UTF-16 code units, one bit each.
+class CharTable
+{
+public:
+    CharTable() : bits(0x10000 / 32, 0) {}
+    explicit CharTable(const CharSet& set) : bits(0x10000 / 32, 0)
+    {
+        Q_FOREACH (const CharSet::Range& r, set.toRanges()) {
+            for (uint c = r.first; c <= r.second; ++c)
+                bits[c >> 5] |= 1u << (c & 31);
+        }
+    }
+
+    bool contains(ushort c) const { return bits[c >> 5] & (1u << (c & 31)); }
+
+private:
+    QVector<quint32> bits;
+};
+
+void findAnchorsScalar(const ushort *text, int from, int length,
+                       const CharTable& table, QVector<int> *positions)
+{
+    for (int i = from; i < length; ++i) {
+        if (table.contains(text[i]))
+            *positions << i;
+    }
+}
+
+// Returns how far the text was searched; the rest is left to the scalar
+// search.
+int findAnchorsVector(const ushort *text, int length, const CharSet& set,
+                      QVector<int> *positions)
+{
+    const QVector<CharSet::Range>& ranges = set.toRanges();
+    const int n = ranges.size();
+    if (n == 0 || n > MaxVectorRanges)
+        return 0;
+    int i = 0;
+
+    // c is in [first, last] iff c - first <= last - first, with unsigned
+    // wrapping arithmetic.
+#if defined(__SSE2__)
+    __m128i firsts[MaxVectorRanges];
+    __m128i spans[MaxVectorRanges];
+    for (int k = 0; k < n; ++k) {
+        firsts[k] = _mm_set1_epi16(short(ranges[k].first));
+        spans[k] = _mm_set1_epi16(short(ranges[k].second - ranges[k].first));
+    }
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 8 <= length; i += 8) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + i));
+        __m128i hit = zero;
+        for (int k = 0; k < n; ++k) {
+            // saturates to zero iff the offset is within the span
+            const __m128i over = _mm_subs_epu16(_mm_sub_epi16(chunk, firsts[k]), spans[k]);
+            hit = _mm_or_si128(hit, _mm_cmpeq_epi16(over, zero));
+        }
+        const int mask = _mm_movemask_epi8(hit);
+        if (mask == 0)
+            continue;
+        for (int b = 0; b < 8; ++b) {
+            if (mask & (1 << (2 * b)))
+                *positions << i + b;
+        }
+    }
+#elif defined(LCA_NEON)
+    uint16x8_t firsts[MaxVectorRanges];
+    uint16x8_t spans[MaxVectorRanges];
+    for (int k = 0; k < n; ++k) {
+        firsts[k] = vdupq_n_u16(ranges[k].first);
+        spans[k] = vdupq_n_u16(ranges[k].second - ranges[k].first);
+    }
+    for (; i + 8 <= length; i += 8) {
+        const uint16x8_t chunk = vld1q_u16(text + i);
+        uint16x8_t hit = vdupq_n_u16(0);
+        for (int k = 0; k < n; ++k)
+            hit = vorrq_u16(hit, vcleq_u16(vsubq_u16(chunk, firsts[k]), spans[k]));
+        const uint64x2_t any = vreinterpretq_u64_u16(hit);
+        if ((vgetq_lane_u64(any, 0) | vgetq_lane_u64(any, 1)) == 0)
+            continue;
+        ushort lanes[8];
+        vst1q_u16(lanes, hit);
+        for (int b = 0; b < 8; ++b) {
+            if (lanes[b])
+                *positions << i + b;
+        }
+    }
+#else
+    Q_UNUSED(text);
+    Q_UNUSED(length);
+    Q_UNUSED(positions);
+#endif
+    return i;
+}
+
+void findAnchors(const ushort *text, int length, const CharSet& set,
+                 const CharTable& table, QVector<int> *positions,
+                 AnchorSearch search)
+{
+    int from = 0;
+    if (search == VectorSearch)
+        from = findAnchorsVector(text, length, set, positions);
+    if (from < length)
+        findAnchorsScalar(text, from, length, table, positions);
+}
+
+} // end anon namespace
+
+void findAnchors(const ushort *text, int length, const CharSet& set,
+                 QVector<int> *positions, AnchorSearch search)
+{
+    findAnchors(text, length, set, CharTable(set), positions, search);
+}
+
+struct Prefilter::Data
+{
+    Data() : context(0) {}
+
+    // union of the anchors of all the patterns
+    CharSet anchors;
+    CharTable anchorTable;
+    // anchors and alphabet of each pattern
+    QList<CharTable> patternAnchors;
+    QList<CharTable> alphabets;
+    int context;
+};
+
+Prefilter::Prefilter()
+{
+}
+
+// Analyses the patterns.  The prefilter is disabled if any of them uses
+// syntax which is not understood, can match without consuming any
+// characters, is anchored with ^ or $, or has long lookarounds.
+Prefilter::Prefilter(const QStringList& patterns)
+{
+    if (patterns.isEmpty())
+        return;
+    QSharedPointer<Data> data(new Data);
+    int lookaround = 0;
+    Q_FOREACH (const QString& pattern, patterns) {
+        PatternNode root;
+        CharSet required;
+        if (!parsePattern(pattern, &root) || isAnchored(root)
+            || !requiredChars(root, &required))
+            return;
+        int length = lookaroundLength(root);
+        if (length == -1 || length > MaxLookaround)
+            return;
+        lookaround = qMax(lookaround, length);
+        data->anchors.add(required);
+        data->patternAnchors << CharTable(required);
+        data->alphabets << CharTable(consumableChars(root));
+    }
+    data->anchorTable = CharTable(data->anchors);
+    // one more for the end of the text, which \b and lookaheads notice
+    data->context = lookaround + 1;
+    d = data;
+}
+
+bool Prefilter::isEnabled() const
+{
+    return !d.isNull();
+}
+
+int Prefilter::context() const
+{
+    return d ? d->context : 0;
+}
+
+QVector<QPair<int, int> > Prefilter::windows(const QString& text,
+                                             AnchorSearch search) const
+{
+    QVector<QPair<int, int> > runs;
+    if (!d) {
+        runs << qMakePair(0, text.length());
+        return runs;
+    }
+
+    const ushort *data = text.utf16();
+    const int length = text.length();
+    QVector<int> anchors;
+    findAnchors(data, length, d->anchors, d->anchorTable, &anchors, search);
+
+    // The runs of a pattern's alphabet are disjoint, so each anchor within
+    // a run already found is skipped, and each character is visited at most
+    // once per pattern.
+    const int patterns = d->alphabets.size();
+    QVector<int> coveredUntil(patterns, 0);
+    Q_FOREACH (int anchor, anchors) {
+        const ushort c = data[anchor];
+        for (int p = 0; p < patterns; ++p) {
+            if (anchor < coveredUntil[p] || !d->patternAnchors[p].contains(c))
+                continue;
+            const CharTable& alphabet = d->alphabets[p];
+            int start = anchor;
+            while (start > 0 && alphabet.contains(data[start - 1]))
+                --start;
+            int end = anchor + 1;
+            while (end < length && alphabet.contains(data[end]))
+                ++end;
+            coveredUntil[p] = end;
+            runs << qMakePair(start, end);
+        }
+    }
+
+    // Merge overlapping and adjacent runs: a match may run from one into
+    // the other.
+    std::sort(runs.begin(), runs.end());
+    QVector<QPair<int, int> > merged;
+    for (int i = 0; i < runs.size(); ++i) {
+        if (!merged.isEmpty() && runs[i].first <= merged.last().second)
+            merged.last().second = qMax(merged.last().second, runs[i].second);
+        else
+            merged << runs[i];
+    }
+    return merged;
+}
+
+} // end namespace Internal
+} // end namespace ContentAction
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef PREFILTER_H
+#define PREFILTER_H
+
+#include "pattern.h"
+
+#include <QSharedPointer>
+#include <QStringList>
+
+namespace ContentAction {
+namespace Internal {
+
+enum AnchorSearch {
+    ScalarSearch,
+    VectorSearch    // SSE2 or NEON where available, scalar otherwise
+};
+
+// Appends the positions of the code units of \a text which are in \a set to
+// \a positions, in increasing order.
+LCA_EXPORT void findAnchors(const ushort *text, int length, const CharSet& set,
+                            QVector<int> *positions,
+                            AnchorSearch search = VectorSearch);
+
+// Tells where in a text the highlighter regexps can match, without running
+// them.  Every match of a regexp contains one of its anchor characters,
+// and consists of the characters the regexp can consume, its alphabet.  So
+// a match lies within a run of alphabet characters around an anchor; text
+// outside such runs needs no regexp matching at all.
+class LCA_EXPORT Prefilter
+{
+public:
+    Prefilter();
+    explicit Prefilter(const QStringList& patterns);
+
+    // False if some pattern could not be analysed; then all of the text
+    // must be scanned.
+    bool isEnabled() const;
+    // How many characters around a window the regexps may look at.
+    int context() const;
+    // Returns the sorted, disjoint [start, end) ranges of \a text in which
+    // all the matches of the patterns lie.
+    QVector<QPair<int, int> > windows(const QString& text,
+                                      AnchorSearch search = VectorSearch) const;
+
+private:
+    struct Data;
+    QSharedPointer<const Data> d;
+};
+
+} // end namespace Internal
+} // end namespace ContentAction
+
+#endif
@@ -0,0 +1,314 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+#include "regexpcache.h"
+#include "internal.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QThreadStorage>
+
+#define PCRE2_CODE_UNIT_WIDTH 16
+#include <pcre2.h>
+
+#ifndef LCA_VERSION
+#define LCA_VERSION ""
+#endif
+
+namespace ContentAction {
+namespace Internal {
+
+namespace {
+
+const QByteArray Magic("LCAPCRE\1");
+const int HashSize = 20;
+
+// The options QRegularExpression compiles with by default
+const uint32_t CompileOptions = PCRE2_UTF;
+
+// The JIT stack of each thread starts at the size PCRE2 uses by default,
+// and may grow up to this much
+const PCRE2_SIZE JitStackStart = 32 * 1024;
+const PCRE2_SIZE JitStackMax = 512 * 1024;
+
+// A JIT stack, which may be used by only one thread at a time
+struct JitStack
+{
+    JitStack() : stack(pcre2_jit_stack_create(JitStackStart, JitStackMax, 0)) {}
+    ~JitStack() { pcre2_jit_stack_free(stack); }
+
+    pcre2_jit_stack *stack;
+};
+
+Q_GLOBAL_STATIC(QThreadStorage<JitStack *>, jitStacks)
+
+// Returns the JIT stack of the calling thread, or null if JIT is not
+// available, so that the default one is used.
+pcre2_jit_stack *jitStack()
+{
+    QThreadStorage<JitStack *> *stacks = jitStacks();
+    if (!stacks->hasLocalData())
+        stacks->setLocalData(new JitStack);
+    return stacks->localData()->stack;
+}
+
+inline pcre2_code *toCode(void *code)
+{
+    return static_cast<pcre2_code *>(code);
+}
+
+QByteArray pcreVersion()
+{
+    // in code units of the library
+    PCRE2_UCHAR version[64];
+    if (pcre2_config(PCRE2_CONFIG_VERSION, version) < 0)
+        return QByteArray();
+    return QString::fromUtf16(reinterpret_cast<const ushort *>(version)).toLatin1();
+}
+
+QString defaultCacheDir()
+{
+    const char *path = ::getenv("CONTENTACTION_REGEXP_CACHE");
+    if (path)
+        return QString::fromLocal8Bit(path);
+    QString base = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation);
+    if (base.isEmpty())
+        return QString();
+    return base + "/libcontentaction";
+}
+
+// Identifies the compiled code: the same pattern compiled by another
+// version of the library or of PCRE2, or on another architecture, gives a
+// different key.
+QByteArray cacheKey(const QString& pattern)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(reinterpret_cast<const char *>(pattern.utf16()),
+                 pattern.length() * sizeof(ushort));
+    hash.addData(QByteArray::number(CompileOptions));
+    hash.addData(LCA_VERSION);
+    hash.addData(pcreVersion());
+    hash.addData(QByteArray::number(int(sizeof(void *))));
+    return hash.result();
+}
+
+// The subdirectory of the cache for this version of the library and of
+// PCRE2 on this architecture.  Processes of other versions keep their files
+// in their own subdirectories, so they do not remove each other's.
+QString versionDir()
+{
+    const QByteArray pcre = pcreVersion();
+    return QString::fromLatin1("lca%1-pcre2-%2-%3bit")
+        .arg(QString::fromLatin1(LCA_VERSION),
+             QString::fromLatin1(pcre.left(pcre.indexOf(' '))),
+             QString::number(int(sizeof(void *)) * 8));
+}
+
+} // end anon namespace
+
+CompiledRegexp::CompiledRegexp(const QString& pattern, const QString& cacheDir,
+                               CacheMode mode)
+    : pattern(pattern), code(0), src(Invalid), matchLimit(0), matchLimitPerChar(0),
+      maxMatchLimit(0), depthLimit(0)
+{
+    QString dir = cacheDir.isEmpty() ? defaultCacheDir() : cacheDir;
+    if (mode == UseCache && !dir.isEmpty())
+        file = dir + '/' + versionDir() + "/highlight-"
+            + QString::fromLatin1(cacheKey(pattern).toHex()) + ".pcre2";
+
+    if (load()) {
+        src = Cached;
+    } else {
+        compile();
+        if (code) {
+            src = Compiled;
+            store();
+        }
+    }
+    if (code)
+        pcre2_jit_compile(toCode(code), PCRE2_JIT_COMPLETE);
+}
+
+CompiledRegexp::~CompiledRegexp()
+{
+    pcre2_code_free(toCode(code));
+}
+
+bool CompiledRegexp::isValid() const
+{
+    return code != 0;
+}
+
+CompiledRegexp::Source CompiledRegexp::source() const
+{
+    return src;
+}
+
+QString CompiledRegexp::cacheFile() const
+{
+    return file;
+}
+
+// The cache file is the magic, the key, a hash of the serialised code and
+// the code itself.  The hash guards against truncated or otherwise broken
+// files, which pcre2_serialize_decode() does not check for.
+bool CompiledRegexp::load()
+{
+    if (file.isEmpty())
+        return false;
+    QFile f(file);
+    if (!f.open(QIODevice::ReadOnly))
+        return false;
+    const QByteArray data = f.readAll();
+    const int header = Magic.size() + 2 * HashSize;
+    if (data.size() <= header || !data.startsWith(Magic)
+        || data.mid(Magic.size(), HashSize) != cacheKey(pattern))
+        return false;
+    const QByteArray serialized = data.mid(header);
+    if (data.mid(Magic.size() + HashSize, HashSize)
+        != QCryptographicHash::hash(serialized, QCryptographicHash::Sha1))
+        return false;
+
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(serialized.constData());
+    if (pcre2_serialize_get_number_of_codes(bytes) != 1)
+        return false;
+    pcre2_code *decoded = 0;
+    if (pcre2_serialize_decode(&decoded, 1, bytes, 0) != 1) {
+        LCA_WARNING << "ignoring incompatible regexp cache" << file;
+        return false;
+    }
+    code = decoded;
+    return true;
+}
+
+void CompiledRegexp::compile()
+{
+    int error;
+    PCRE2_SIZE offset;
+    code = pcre2_compile(reinterpret_cast<PCRE2_SPTR>(pattern.utf16()), pattern.length(),
+                         CompileOptions, &error, &offset, 0);
+    if (!code) {
+        PCRE2_UCHAR message[256];
+        pcre2_get_error_message(error, message, sizeof(message) / sizeof(*message));
+        LCA_WARNING << "invalid regexp at" << offset << ":"
+                    << QString::fromUtf16(reinterpret_cast<const ushort *>(message));
+    }
+}
+
+void CompiledRegexp::store() const
+{
+    if (file.isEmpty())
+        return;
+    const pcre2_code *codes[] = { toCode(code) };
+    uint8_t *bytes;
+    PCRE2_SIZE size;
+    if (pcre2_serialize_encode(codes, 1, &bytes, &size, 0) != 1)
+        return;
+    const QByteArray serialized(reinterpret_cast<const char *>(bytes), int(size));
+    pcre2_serialize_free(bytes);
+
+    QDir().mkpath(QFileInfo(file).path());
+    QSaveFile f(file);
+    if (!f.open(QIODevice::WriteOnly))
+        return;
+    f.write(Magic);
+    f.write(cacheKey(pattern));
+    f.write(QCryptographicHash::hash(serialized, QCryptographicHash::Sha1));
+    f.write(serialized);
+    if (!f.commit()) {
+        LCA_WARNING << "cannot write regexp cache" << file;
+        return;
+    }
+    prune();
+}
+
+// Removes the cache files of other patterns next to the file.  Only the
+// regexp of the current rules is worth keeping; the others in the same
+// subdirectory were compiled by the same version of the library for rules
+// which have changed since.
+void CompiledRegexp::prune() const
+{
+    QFileInfo info(file);
+    QDir dir = info.dir();
+    Q_FOREACH (const QString& name,
+               dir.entryList(QStringList("highlight-*.pcre2"), QDir::Files)) {
+        if (name != info.fileName())
+            dir.remove(name);
+    }
+}
+
+void CompiledRegexp::setLimits(quint32 matchLimit, quint32 perChar, quint32 maxMatchLimit,
+                               quint32 depthLimit)
+{
+    this->matchLimit = matchLimit;
+    this->matchLimitPerChar = perChar;
+    this->maxMatchLimit = maxMatchLimit;
+    this->depthLimit = depthLimit;
+}
+
+bool CompiledRegexp::match(const QString& subject, int offset, QVector<int> *captures,
+                           Failure *failure) const
+{
+    if (failure)
+        *failure = NoFailure;
+    if (!code || offset < 0 || offset > subject.length())
+        return false;
+    pcre2_match_data *data = pcre2_match_data_create_from_pattern(toCode(code), 0);
+    if (!data)
+        return false;
+    pcre2_match_context *context = pcre2_match_context_create(0);
+    if (context) {
+        pcre2_jit_stack_assign(context, 0, jitStack());
+        if (matchLimit) {
+            // the budget grows with the text, up to the cap
+            quint64 limit = matchLimit + quint64(matchLimitPerChar) * (subject.length() - offset);
+            if (maxMatchLimit)
+                limit = qMin(limit, quint64(maxMatchLimit));
+            pcre2_set_match_limit(context, quint32(qMin(limit, quint64(0xffffffffu))));
+        }
+        if (depthLimit)
+            pcre2_set_depth_limit(context, depthLimit);
+    }
+    int rc = pcre2_match(toCode(code), reinterpret_cast<PCRE2_SPTR>(subject.utf16()),
+                         subject.length(), offset, 0, data, context);
+    if (rc < 0 && rc != PCRE2_ERROR_NOMATCH && failure) {
+        if (rc == PCRE2_ERROR_MATCHLIMIT || rc == PCRE2_ERROR_DEPTHLIMIT)
+            *failure = LimitReached;
+        else if (rc == PCRE2_ERROR_JIT_STACKLIMIT)
+            *failure = StackExhausted;
+        else
+            *failure = MatchError;
+    }
+    if (rc > 0) {
+        const PCRE2_SIZE *ovector = pcre2_get_ovector_pointer(data);
+        const int pairs = pcre2_get_ovector_count(data);
+        captures->resize(2 * pairs);
+        for (int i = 0; i < 2 * pairs; ++i)
+            (*captures)[i] = i < 2 * rc && ovector[i] != PCRE2_UNSET ? int(ovector[i]) : -1;
+    }
+    pcre2_match_data_free(data);
+    pcre2_match_context_free(context);
+    return rc > 0;
+}
+
+} // end namespace Internal
+} // end namespace ContentAction
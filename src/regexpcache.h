@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef REGEXPCACHE_H
+#define REGEXPCACHE_H
+
+#include "contentaction.h"
+
+#include <QString>
+#include <QVector>
+
+namespace ContentAction {
+namespace Internal {
+
+// A regexp compiled with PCRE2 directly instead of QRegularExpression, so
+// that the compiled code can be kept in a cache file between processes.
+// The regexp is compiled with the same options QRegularExpression uses by
+// default.
+class LCA_EXPORT CompiledRegexp
+{
+public:
+    enum Source {
+        Invalid,
+        Compiled,   // compiled, and stored in the cache if possible
+        Cached      // loaded from the cache
+    };
+
+    enum CacheMode {
+        UseCache,   // load from and store to the cache
+        NoCache     // only compile
+    };
+
+    // Why match() found nothing although there may have been a match
+    enum Failure {
+        NoFailure,
+        LimitReached,   // the match or the depth limit was reached
+        StackExhausted, // the JIT stack was too small
+        MatchError      // PCRE2 failed otherwise, like on invalid UTF-16
+    };
+
+    // Loads the compiled \a pattern from \a cacheDir, or compiles it if
+    // there is no usable cache file.  An empty cacheDir means the default
+    // cache directory.  The files are kept in a subdirectory for the version
+    // of the library and of PCRE2 and the architecture.  Storing a new cache
+    // file removes the others in that subdirectory, which were made for
+    // other patterns.
+    explicit CompiledRegexp(const QString& pattern, const QString& cacheDir = QString(),
+                            CacheMode mode = UseCache);
+    ~CompiledRegexp();
+
+    bool isValid() const;
+    Source source() const;
+    QString cacheFile() const;
+
+    // Limits the work of each match() call against catastrophic
+    // backtracking: matching gives up after \a matchLimit steps, plus \a
+    // perChar steps for each character of the subject after the offset but
+    // \a maxMatchLimit steps at most, or when the backtracking gets deeper
+    // than \a depthLimit.  0 is no limit.
+    void setLimits(quint32 matchLimit, quint32 perChar, quint32 maxMatchLimit,
+                   quint32 depthLimit);
+
+    // Finds the first match at or after \a offset.  Sets \a captures to the
+    // start and end of the match and of each capture group, -1 for the
+    // groups which did not participate.  Sets \a failure to why there was no
+    // match if it was not for the lack of one.  The JIT code runs on a stack
+    // of a fixed size of the calling thread.
+    bool match(const QString& subject, int offset, QVector<int> *captures,
+               Failure *failure = 0) const;
+
+private:
+    Q_DISABLE_COPY(CompiledRegexp)
+
+    bool load();
+    void compile();
+    void store() const;
+    void prune() const;
+
+    QString pattern;
+    QString file;
+    // the pcre2_code_16
+    void *code;
+    Source src;
+    quint32 matchLimit;
+    quint32 matchLimitPerChar;
+    quint32 maxMatchLimit;
+    quint32 depthLimit;
+};
+
+} // end namespace Internal
+} // end namespace ContentAction
+
+#endif
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+#include "scanners.h"
+
+namespace ContentAction {
+namespace Internal {
+
+namespace {
+
+template <typename Char>
+int matchFrom(const GeneratedScanner& scanner, const Char *text, int length, int start)
+{
+    const int other = ScannerClassCount - 1;
+    quint32 state = 1;
+    int end = -1;
+    for (int i = start; i < length; ++i) {
+        const Char c = text[i];
+        const quint32 next = scanner.transitions[state * ScannerClassCount
+                                                 + (c < 128 ? ScannerClasses[c] : other)];
+        if (next & 1)
+            end = i;
+        state = next >> 1;
+        if (state == 0)
+            return end;
+    }
+    return scanner.accepts[state] ? length : end;
+}
+
+} // end anon namespace
+
+int GeneratedScanner::match(const ushort *text, int length, int start) const
+{
+    return matchFrom(*this, text, length, start);
+}
+
+int GeneratedScanner::match(const uchar *text, int length, int start) const
+{
+    return matchFrom(*this, text, length, start);
+}
+
+const GeneratedScanner *generatedScanner(const QString& pattern)
+{
+    for (int i = 0; i < GeneratedScannerCount; ++i) {
+        if (pattern == QString::fromUtf8(GeneratedScanners[i].pattern))
+            return &GeneratedScanners[i];
+    }
+    return 0;
+}
+
+QList<const GeneratedScanner *> generatedScanners()
+{
+    QList<const GeneratedScanner *> result;
+    for (int i = 0; i < GeneratedScannerCount; ++i)
+        result << &GeneratedScanners[i];
+    return result;
+}
+
+} // end namespace Internal
+} // end namespace ContentAction
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef SCANNERS_H
+#define SCANNERS_H
+
+#include "contentaction.h"
+
+#include <QList>
+#include <QString>
+
+namespace ContentAction {
+namespace Internal {
+
+// A deterministic scanner generated by data/gen-scanners from one of the
+// highlighter regexps of highlight1.xml.  It finds the same match as the
+// regexp anchored at a position, in time linear in the length of the text
+// it looks at.  GeneratedBackend runs the scanners from all the positions of
+// a text at once, so that it finds the first match in one pass.
+struct LCA_EXPORT GeneratedScanner
+{
+    // Returns the end of the match which starts at \a start, or -1 if the
+    // regexp does not match there.
+    int match(const ushort *text, int length, int start) const;
+    // The same for UTF-8 text.  The scanners match only ASCII characters,
+    // so they find the same matches in the bytes of a text as in its UTF-16
+    // code units.
+    int match(const uchar *text, int length, int start) const;
+
+    const char *name;
+    const char *pattern;
+    // ScannerClassCount entries for each state, the next state times two,
+    // plus one if the text up to the character matches; state 0 is the
+    // dead state and state 1 the start state
+    const quint32 *transitions;
+    // whether the text up to the end matches, for each state
+    const uchar *accepts;
+    // the number of states
+    int states;
+};
+
+// The generated scanner of \a pattern, or 0 if there is none.
+LCA_EXPORT const GeneratedScanner *generatedScanner(const QString& pattern);
+LCA_EXPORT QList<const GeneratedScanner *> generatedScanners();
+
+// Defined by the generated code.  The characters are mapped to classes
+// which the regexps don't tell apart; all the non-ASCII characters are in
+// the last class.
+extern const int ScannerClassCount;
+extern const uchar ScannerClasses[128];
+extern const GeneratedScanner GeneratedScanners[];
+extern const int GeneratedScannerCount;
+
+} // end namespace Internal
+} // end namespace ContentAction
+
+#endif
@@ -24,14 +24,24 @@
 
 #include <MDesktopEntry>
 
-#include <QDBusInterface>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+#include <QDBusConnection>
 #include <QDBusMessage>
 #include <QStringList>
 #include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QDBusServiceWatcher>
 
 #define MAPPER_SERVICENAME "com.nokia.MServiceFw"
 #define MAPPER_PATH "/"
 #define MAPPER_INTERFACE "com.nokia.MServiceFwIf"
+#define IMPLEMENTOR_PATH "/"
 
 using namespace ContentAction::Internal;
 
@@ -47,21 +57,7 @@ ServiceFwPrivate::ServiceFwPrivate(QSharedPointer<MDesktopEntry> desktopEntry,
 
 void ServiceFwPrivate::trigger(bool wait) const
 {
-    QString method;
-    QDBusInterface *proxy = resolver().implementorForAction(serviceFwMethod, method);
-    if (!proxy)
-        return;
-    QDBusPendingCallWatcher watcher(proxy->asyncCall(method, params));
-
-    if (wait) {
-        watcher.waitForFinished();
-        if (watcher.isError()) {
-            LCA_WARNING << "error reply from service implementor"
-                        << watcher.error().message()
-                        << "when trying to call" << serviceFwMethod
-                        << "on" << proxy->service();
-        }
-    }
+    resolver().callAction(serviceFwMethod, QVariantList() << QVariant(params), wait);
 }
 
 ServiceResolver& resolver()
@@ -70,10 +66,32 @@ ServiceResolver& resolver()
     return resolver;
 }
 
+/// Returns the file where the interface -> implementor mappings are kept
+/// between runs.  It may be overridden via the $CONTENTACTION_SERVICE_CACHE
+/// environment variable.
+static QString cachePath()
+{
+    const char *path = ::getenv("CONTENTACTION_SERVICE_CACHE");
+    if (path)
+        return QString::fromLocal8Bit(path);
+    const char *d = ::getenv("XDG_CACHE_HOME");
+    QString cacheHome = d ? QString::fromLocal8Bit(d) : QDir::homePath() + "/.cache";
+    return cacheHome + "/contentaction/servicefw.list";
+}
+
 ServiceResolver::ServiceResolver()
+    : prefetched(false)
 {
     QDBusConnection conn = QDBusConnection::sessionBus();
 
+    // Forget the implementors when they go away; the mapper is asked again
+    // the next time the interface is needed.
+    implementorWatcher = new QDBusServiceWatcher(this);
+    implementorWatcher->setConnection(conn);
+    implementorWatcher->setWatchMode(QDBusServiceWatcher::WatchForUnregistration);
+    connect(implementorWatcher, SIGNAL(serviceUnregistered(QString)),
+            this, SLOT(onImplementorUnregistered(QString)));
+
     conn.connect(MAPPER_SERVICENAME,
                  MAPPER_PATH,
                  MAPPER_INTERFACE,
@@ -85,14 +103,19 @@ ServiceResolver::ServiceResolver()
                  MAPPER_INTERFACE,
                  "serviceUnavailable",
                  this,
-                 SLOT(onServiceUnavailable(QString,QString)));
+                 SLOT(onServiceUnavailable(QString)));
+
+    // Start with the mappings known by the previous runs; they are
+    // revalidated in the background on first use.
+    QFile file(cachePath());
+    readKeyValues(file, cached);
+    resolved = cached;
+    Q_FOREACH (const QString& implementor, resolved)
+        watch(implementor);
 }
 
 ServiceResolver::~ServiceResolver()
 {
-    Q_FOREACH (QDBusInterface* proxy, proxies)
-        delete proxy;
-    proxies.clear();
 }
 
 /// A slot connected to the serviceAvailable signal from Meego service mapper.
@@ -105,82 +128,221 @@ void ServiceResolver::onServiceAvailable(QString implementor, QString interface)
     // anything else but clear our understanging about who's the preferred
     // implementor of the interface.
 
-    // Remove the old implementor (and its proxy)
+    if (cached.remove(interface))
+        saveCache();
+
+    // Remove the old implementor
     if (resolved.contains(interface)) {
         QString oldImplementor = resolved.take(interface);
 
         if (resolved.keys(oldImplementor).isEmpty())
-            // The old implementor implemented only this interface; the proxy
-            // can be deleted.
-            delete proxies.take(oldImplementor);
+            // The old implementor implemented only this interface; no need
+            // to watch it anymore.
+            implementorWatcher->removeWatchedService(oldImplementor);
     }
 }
 
-/// A slot connected to the serviceUnavailable signal from Meego service mapper.
+/// A slot connected to the serviceUnavailable signal from Meego service
+/// mapper.
 void ServiceResolver::onServiceUnavailable(QString implementor)
+{
+    QStringList interfaces = cached.keys(implementor);
+    if (!interfaces.isEmpty()) {
+        Q_FOREACH (const QString& interface, interfaces)
+            cached.remove(interface);
+        saveCache();
+    }
+    onImplementorUnregistered(implementor);
+}
+
+/// A slot called when the bus name of an implementor goes away.  The mapper
+/// is asked again the next time one of its interfaces is needed.
+void ServiceResolver::onImplementorUnregistered(QString implementor)
 {
     // Check which interfaces now become unusable
     QStringList interfaces = resolved.keys(implementor);
     Q_FOREACH (const QString& interface, interfaces)
         resolved.remove(interface);
-    if (proxies.contains(implementor))
-        delete proxies.take(implementor);
+    implementorWatcher->removeWatchedService(implementor);
+}
+
+void ServiceResolver::watch(const QString& implementor)
+{
+    if (!implementorWatcher->watchedServices().contains(implementor))
+        implementorWatcher->addWatchedService(implementor);
 }
 
-/// Returns the name of the current implementor of an interface. If an error
-/// occurs (e.g., we cannot connect to the Meego service mapper), returns an
-/// empty string.
-QString ServiceResolver::implementorName(const QString& interface)
+// Writes the mappings confirmed by the service mapper to the cache file.
+void ServiceResolver::saveCache()
 {
-    if (resolved.contains(interface))
-        return resolved[interface];
+    QString targetFileName = cachePath();
+    QDir().mkpath(QFileInfo(targetFileName).absolutePath());
+    QFile outFile(targetFileName + ".temp");
+    if (!outFile.open(QIODevice::WriteOnly)) {
+        LCA_WARNING << "cannot write" << outFile.fileName();
+        return;
+    }
+    QTextStream stream(&outFile);
+
+    stream << "[Service Mappings]\n";
+    for (QHash<QString, QString>::ConstIterator it = cached.constBegin();
+         it != cached.constEnd(); ++it) {
+        stream << it.key() << "=" << it.value() << "\n";
+    }
+    stream.flush();
+    outFile.close();
+
+    ::rename((targetFileName + ".temp").toLocal8Bit().constData(),
+             targetFileName.toLocal8Bit().constData());
+}
+
+// Revalidates all the cached mappings at once; the lookups are pipelined so
+// this costs about one mapper round-trip, and nobody waits for it.
+void ServiceResolver::prefetch()
+{
+    prefetched = true;
+    Q_FOREACH (const QString& interface, cached.keys())
+        lookup(interface);
+}
+
+/// Starts an asynchronous query for the current implementor of \a interface,
+/// unless one is already in progress.  Calls queued for the interface are
+/// dispatched when the service mapper replies.
+void ServiceResolver::lookup(const QString& interface)
+{
+    if (lookups.contains(interface))
+        return;
 
-    // A blocking call
     QDBusMessage message =
         QDBusMessage::createMethodCall(MAPPER_SERVICENAME, MAPPER_PATH,
                                        MAPPER_INTERFACE, "serviceName");
     message.setArguments(QVariantList() << interface);
 
-    QDBusMessage reply = QDBusConnection::sessionBus().call(message);
-    if (reply.type() != QDBusMessage::ReplyMessage || reply.arguments().size() == 0) {
-        LCA_WARNING << "invalid reply from service mapper" << reply.errorName();
-        return "";
+    QDBusPendingCallWatcher *watcher =
+        new QDBusPendingCallWatcher(QDBusConnection::sessionBus().asyncCall(message), this);
+    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
+            this, SLOT(onImplementorResolved(QDBusPendingCallWatcher*)));
+    lookups.insert(interface, watcher);
+}
+
+/// A slot called when the service mapper has replied to a lookup.
+void ServiceResolver::onImplementorResolved(QDBusPendingCallWatcher *watcher)
+{
+    watcher->deleteLater();
+    QString interface = lookups.key(watcher);
+    if (interface.isEmpty())
+        return;
+    lookups.remove(interface);
+    QList<PendingCall> calls = queued.take(interface);
+
+    QDBusPendingReply<QString> reply = *watcher;
+    if (reply.isError()) {
+        LCA_WARNING << "invalid reply from service mapper for" << interface
+                    << reply.error().name() << reply.error().message();
+        // The mapper is not there; trust what it told us the last time.
+        if (cached.contains(interface)) {
+            Q_FOREACH (const PendingCall& call, calls)
+                dispatch(cached.value(interface), interface, call);
+        } else if (calls.size() > 0) {
+            LCA_WARNING << "dropping" << calls.size() << "calls to" << interface
+                        << "with no known implementor";
+        }
+        return;
     }
-    QString service = reply.arguments()[0].toString();
-    if (service.size() == 0) {
+    QString service = reply.value();
+    if (service.isEmpty()) {
         // don't insert to the "resolved" map
-        return "";
+        if (calls.size() > 0)
+            LCA_WARNING << "no implementor for" << interface;
+        resolved.remove(interface);
+        if (cached.remove(interface))
+            saveCache();
+        return;
     }
     resolved.insert(interface, service);
-    return service;
+    watch(service);
+    if (cached.value(interface) != service) {
+        cached.insert(interface, service);
+        saveCache();
+    }
+    Q_FOREACH (const PendingCall& call, calls)
+        dispatch(service, interface, call);
 }
 
-/// Returns the proxy object for the current implementor of the given
-/// interface.
-QDBusInterface* ServiceResolver::implementor(const QString& interface)
+// Sends the call to the implementor \a name as a plain method call message.
+// Unlike QDBusInterface, this doesn't need to introspect (and thus possibly
+// activate) the implementor beforehand.
+void ServiceResolver::dispatch(const QString& name, const QString& interface,
+                               const PendingCall& call)
 {
-    QString name = implementorName(interface);
-    if (!proxies.contains(name)) {
-        proxies.insert(name, new QDBusInterface(name, "/", interface, QDBusConnection::sessionBus()));
+    QDBusMessage message =
+        QDBusMessage::createMethodCall(name, IMPLEMENTOR_PATH, interface, call.method);
+    message.setArguments(call.args);
+    QDBusPendingCallWatcher *watcher =
+        new QDBusPendingCallWatcher(QDBusConnection::sessionBus().asyncCall(message));
+    const QString target = interface + "." + call.method;
+    Internal::LaunchSlotRef slot = call.slot;
+
+    connect(watcher, &QDBusPendingCallWatcher::finished,
+            [name, target, slot](QDBusPendingCallWatcher *w) mutable {
+        if (w->isError()) {
+            LCA_WARNING << "error reply from service implementor"
+                        << w->error().message()
+                        << "when trying to call" << target
+                        << "on" << name;
+        }
+        slot.clear();
+        w->deleteLater();
+    });
+
+    if (call.wait)
+        watcher->waitForFinished();
+}
+
+/// Calls \a method with \a args on the current implementor of \a interface.
+/// If the implementor is not known yet, the call is queued until the service
+/// mapper tells it; concurrent calls for the same interface share a single
+/// lookup.  If \a wait is true, blocks until the implementor has replied.
+void ServiceResolver::call(const QString& interface, const QString& method,
+                           const QVariantList& args, bool wait)
+{
+    PendingCall pending = { method, args, wait, Internal::currentLaunchSlot() };
+
+    if (!prefetched)
+        prefetch();
+
+    if (resolved.contains(interface)) {
+        dispatch(resolved.value(interface), interface, pending);
+        return;
+    }
+
+    queued[interface].append(pending);
+    lookup(interface);
+
+    if (wait) {
+        // Delivers the reply synchronously, which also dispatches (and waits
+        // for) our call.
+        QDBusPendingCallWatcher *watcher = lookups.value(interface);
+        if (watcher)
+            watcher->waitForFinished();
     }
-    return proxies[name];
 }
 
-// Splits action to interface.method and looks up the proxy for the interface.
-// Returns the method name in \a method.
-QDBusInterface *ServiceResolver::implementorForAction(const QString& action,
-                                                      QString& method)
+// Splits action to interface.method and calls the method on the current
+// implementor of the interface.
+void ServiceResolver::callAction(const QString& action, const QVariantList& args,
+                                 bool wait)
 {
     // Get the service fw interface from the action name
     int dotIx = action.lastIndexOf(".");
     if (dotIx < 1) {
         LCA_WARNING << "invalid action name" << action;
-        return 0;
+        return;
     }
     // Action, e.g., "com.nokia.video-interface.play"
     QString interface = action.left(dotIx);
-    method = action.right(action.size() - dotIx - 1);
-    return implementor(interface);
+    QString method = action.right(action.size() - dotIx - 1);
+    call(interface, method, args, wait);
 }
 
 }
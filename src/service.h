@@ -25,30 +25,62 @@
 #include <QObject>
 #include <QString>
 #include <QHash>
+#include <QList>
+#include <QSharedPointer>
+#include <QVariantList>
 
-class QDBusInterface;
+class QDBusPendingCallWatcher;
+class QDBusServiceWatcher;
 
 namespace ContentAction
 {
 
+namespace Internal {
+class LaunchSlot;
+}
+
 class ServiceResolver : public QObject
 {
     Q_OBJECT
 public:
     ServiceResolver();
     ~ServiceResolver();
-    QDBusInterface* implementor(const QString& interface);
-    QDBusInterface* implementorForAction(const QString& action, QString& method);
+    void call(const QString& interface, const QString& method,
+              const QVariantList& args, bool wait);
+    void callAction(const QString& action, const QVariantList& args, bool wait);
 
 private Q_SLOTS:
     void onServiceAvailable(QString, QString);
     void onServiceUnavailable(QString);
+    void onImplementorUnregistered(QString);
+    void onImplementorResolved(QDBusPendingCallWatcher *watcher);
 
 private:
-    QString implementorName(const QString&);
+    struct PendingCall {
+        QString method;
+        QVariantList args;
+        bool wait;
+        // keeps the launch in progress until the call is answered
+        QSharedPointer<Internal::LaunchSlot> slot;
+    };
+
+    void lookup(const QString& interface);
+    void dispatch(const QString& implementor, const QString& interface,
+                  const PendingCall& call);
+    void watch(const QString& implementor);
+    void prefetch();
+    void saveCache();
 
+    // interface -> implementor; the calls go to IMPLEMENTOR_PATH on it
     QHash<QString, QString> resolved;
-    QHash<QString, QDBusInterface*> proxies;
+    // the mappings as stored in the cache file
+    QHash<QString, QString> cached;
+    bool prefetched;
+    QDBusServiceWatcher *implementorWatcher;
+    // interface -> service mapper call in progress
+    QHash<QString, QDBusPendingCallWatcher*> lookups;
+    // interface -> calls waiting for the implementor to be known
+    QHash<QString, QList<PendingCall> > queued;
 };
 
 ServiceResolver& resolver();
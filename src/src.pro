@@ -7,6 +7,7 @@ QT = core xml dbus
 CONFIG += link_pkgconfig hide_symbols create_pc create_prl no_install_prl
 CONFIG -= link_prl
 PKGCONFIG += gio-2.0 gio-unix-2.0
+PKGCONFIG += libpcre2-16
 PKGCONFIG += mlite$${QT_MAJOR_VERSION}
 
 target.path = $$[QT_INSTALL_LIBS]
@@ -14,25 +15,56 @@ INSTALLS += target
 
 DEFINES += DEFAULT_ACTIONS=\\\"\"$$CONTENTACTION_DATADIR\"\\\"
 DEFINES += LCA_BUILD
+DEFINES += LCA_VERSION=\\\"\"$$VERSION\"\\\"
 DEFINES += QT_NO_KEYWORDS # make glib happy
 
 HEADERS += \
     internal.h \
     contentaction.h \
     service.h \
+    highlight.h \
+    configwatcher.h \
+    automaton.h \
+    backends.h \
+    pattern.h \
+    prefilter.h \
+    regexpcache.h \
+    scanners.h \
     contentinfo.h
 
 SOURCES += \
     contentaction.cpp \
+    launch.cpp \
     service.cpp \
     dbus.cpp \
+    activatable.cpp \
     exec.cpp \
     mime.cpp \
     highlighter.cpp \
     highlight.cpp \
+    automaton.cpp \
+    backends.cpp \
+    pattern.cpp \
+    prefilter.cpp \
+    regexpcache.cpp \
+    scanners.cpp \
+    blockhighlighter.cpp \
+    highlightreader.cpp \
     config.cpp \
+    configwatcher.cpp \
     contentinfo.cpp
 
+# The deterministic scanners of the built-in highlighter regexps
+SCANNER_RULES = ../data/highlight1.xml.in
+
+genscanners.input = SCANNER_RULES
+genscanners.output = scanners_generated.cpp
+genscanners.commands = $$PWD/../data/gen-regexps > scanners.sed && sed -f scanners.sed < ${QMAKE_FILE_IN} > highlight1.xml && $$PWD/../data/gen-scanners highlight1.xml ${QMAKE_FILE_OUT}
+genscanners.depends = $$PWD/../data/gen-regexps $$PWD/../data/regextest2.py $$PWD/../data/gen-scanners
+genscanners.name = genscanners
+genscanners.variable_out = SOURCES
+QMAKE_EXTRA_COMPILERS += genscanners
+
 include.path = $$CONTENTACTION_INCLUDEDIR
 include.files = contentaction.h \
                 contentinfo.h
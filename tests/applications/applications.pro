@@ -19,10 +19,12 @@ desktop_tests.files = \
     plainmusicplayer.desktop \
     complexmusic.desktop \
     uriprinter.desktop \
+    org.example.Activatable.desktop \
     gallerywithfilename.desktop \
     browser.desktop \
     special-browser.desktop \
-    regexpmatcher.desktop 
+    regexpmatcher.desktop \
+    queuedlaunch.desktop
 INSTALLS += desktop_tests
 
 unix{
@@ -1,5 +1,6 @@
 #!/usr/bin/python3
 import os
+from sys import stdout
 import dbus, dbus.service, dbus.mainloop.glib
 from gi.repository import GObject as gobject
 
@@ -46,4 +47,6 @@ class ServiceMapper(dbus.service.Object):
 
 dbus.mainloop.glib.DBusGMainLoop(set_as_default=True)
 napper = ServiceMapper('/')
+print("started")
+stdout.flush()
 gobject.MainLoop().run()
@@ -1,4 +1,5 @@
 #include <QObject>
+#include <QtDBus/QtDBus>
 #include <QtTest/QtTest>
 
 #include "contentaction.h"
@@ -18,6 +19,28 @@ dump_action (const Action &action)
     qDebug() << "invalid";
 }
 
+// Records the launches of queuedlaunch.desktop, in the order they arrive.
+class LaunchReceiver : public QObject
+{
+  Q_OBJECT
+  Q_CLASSINFO ("D-Bus Interface", "org.example.LaunchQueue")
+
+public:
+  QStringList launched;
+
+public Q_SLOTS:
+  void launch (const QStringList &params)
+  {
+    launched << params.join (",");
+  }
+};
+
+Action
+queued (const QString &param)
+{
+  return Action::launcherAction ("queuedlaunch.desktop", QStringList() << param);
+}
+
 class TestAction : public QObject
 {
   Q_OBJECT
@@ -41,6 +64,118 @@ private Q_SLOTS:
     QVERIFY (action2.isValid());
     QCOMPARE (action1.name(), action2.name());
   }
+
+  void
+  test_duplicate_triggers ()
+  {
+    // Triggering the same action repeatedly in a quick succession should
+    // launch it only once.
+
+    Action action = Action::launcherAction ("uriprinter.desktop",
+                                            QStringList() << "dup1");
+    QVERIFY (action.isValid());
+
+    LaunchStatistics before = launchStatistics();
+    action.trigger();
+    action.trigger();
+    action.trigger();
+    LaunchStatistics after = launchStatistics();
+
+    QCOMPARE (after.launched - before.launched, quint64(1));
+    QCOMPARE (after.suppressed - before.suppressed, quint64(2));
+
+    // Different parameters are a different launch.
+    Action::launcherAction ("uriprinter.desktop",
+                            QStringList() << "dup2").trigger();
+    QCOMPARE (launchStatistics().launched - before.launched, quint64(2));
+  }
+
+  void
+  test_launch_queue ()
+  {
+    // Exec launches are done when trigger() returns, so they never queue and
+    // leave no slot behind, not even with a single slot and no queue.
+
+    const int concurrency = launchConcurrency();
+    const int limit = launchQueueLimit();
+    setLaunchConcurrency (1);
+    setLaunchQueueLimit (0);
+
+    LaunchStatistics before = launchStatistics();
+    QVERIFY (Action::launcherAction ("uriprinter.desktop",
+                                     QStringList() << "queue1")
+             .trigger (BackgroundLaunch));
+    QVERIFY (Action::launcherAction ("uriprinter.desktop",
+                                     QStringList() << "queue2")
+             .trigger (UserLaunch));
+    LaunchStatistics after = launchStatistics();
+
+    QCOMPARE (after.launched - before.launched, quint64(2));
+    QCOMPARE (after.rejected, before.rejected);
+    QCOMPARE (after.running, 0);
+    QCOMPARE (after.queued, 0);
+
+    // Invalid actions are not launched at all.
+    QVERIFY (!Action().trigger (UserLaunch));
+
+    setLaunchConcurrency (concurrency);
+    setLaunchQueueLimit (limit);
+  }
+
+  void
+  test_launch_queue_priorities ()
+  {
+    // A D-Bus launch keeps its slot until the application replies, which
+    // can't happen before the event loop runs, so the next launches queue.
+
+    LaunchReceiver receiver;
+    QDBusConnection bus = QDBusConnection::sessionBus();
+    QVERIFY (bus.registerService ("org.example.LaunchQueue"));
+    QVERIFY (bus.registerObject ("/", &receiver, QDBusConnection::ExportAllSlots));
+    QVERIFY (queued ("a").isValid());
+
+    const int concurrency = launchConcurrency();
+    const int limit = launchQueueLimit();
+    setLaunchConcurrency (1);
+    setLaunchQueueLimit (2);
+
+    LaunchStatistics before = launchStatistics();
+    QVERIFY (queued ("a").trigger (UserLaunch));
+    QVERIFY (queued ("b").trigger (BackgroundLaunch));
+    QVERIFY (queued ("c").trigger (BackgroundLaunch));
+    // The queue is full, so a background launch is refused.
+    QVERIFY (!queued ("d").trigger (BackgroundLaunch));
+    // A user launch takes the place of the newest background launch, and
+    // when there are none left, the queue grows past its limit: the user
+    // launches which were accepted are never dropped.
+    QVERIFY (queued ("e").trigger (UserLaunch));
+    QVERIFY (queued ("f").trigger (UserLaunch));
+    queued ("g").trigger ();
+
+    LaunchStatistics after = launchStatistics();
+    QCOMPARE (after.rejected - before.rejected, quint64(3));
+    QCOMPARE (after.running, 1);
+    QCOMPARE (after.queued, 3);
+    QCOMPARE (after.peakQueued, qMax (before.peakQueued, 3));
+
+    QTRY_COMPARE (receiver.launched, QStringList() << "a" << "e" << "f" << "g");
+    QTRY_COMPARE (launchStatistics().running, 0);
+    QCOMPARE (launchStatistics().launched - before.launched, quint64(4));
+
+    // User launches go ahead of the background launches queued before them.
+    receiver.launched.clear();
+    QVERIFY (queued ("h").trigger (UserLaunch));
+    QVERIFY (queued ("i").trigger (BackgroundLaunch));
+    QVERIFY (queued ("j").trigger (UserLaunch));
+    QTRY_COMPARE (receiver.launched, QStringList() << "h" << "j" << "i");
+    QTRY_COMPARE (launchStatistics().running, 0);
+    QCOMPARE (launchStatistics().rejected, after.rejected);
+
+    setLaunchConcurrency (concurrency);
+    setLaunchQueueLimit (limit);
+    bus.unregisterObject ("/");
+    bus.unregisterService ("org.example.LaunchQueue");
+  }
 };
 
 
@@ -0,0 +1,269 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+// Checks that the automaton finds the same matches as the master regexp of
+// a HighlightScanner, and that each category gets the right backend.
+
+#include "highlight.h"
+#include "automaton.h"
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QRegularExpression>
+#include <QTest>
+#include <QDebug>
+
+using namespace ContentAction::Internal;
+
+namespace {
+
+// Pieces of text which make matches likely
+const char *const Pieces[] = {
+    "a", "b", "c", "d", "f", "o", "q", "x", "y", "z", " ", "\n", ".", "1",
+    "5", "_", "ab", "fo", "xabc", "abcd", "aaaa", "\xc3\xa9", "\xf0\x9f\x98\x80"
+};
+
+QString randomText(int pieces)
+{
+    const int count = sizeof(Pieces) / sizeof(*Pieces);
+    QString text;
+    for (int i = 0; i < pieces; ++i)
+        text += QString::fromUtf8(Pieces[qrand() % count]);
+    return text;
+}
+
+// A scanner matching patterns with the master regexp only
+HighlightScanner masterScanner(const QStringList& patterns)
+{
+    HighlightScanner scanner;
+    QString re("(?:");
+    int group = 1;
+    Q_FOREACH (const QString& pattern, patterns) {
+        if (group > 1)
+            re += '|';
+        re += '(' + pattern + ')';
+        scanner.categories << pattern;
+        scanner.mimeTypes << QStringList();
+        scanner.groups << group;
+        group += 1 + QRegularExpression(pattern).captureCount();
+    }
+    re += ")";
+    scanner.master = QRegularExpression(re);
+    return scanner;
+}
+
+} // end anon namespace
+
+class TestAutomaton : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void supports_data();
+    void supports();
+    void equivalence_data();
+    void equivalence();
+    void catastrophic();
+    void longPartialMatches();
+    void backends();
+    void reuse();
+};
+
+void TestAutomaton::initTestCase()
+{
+    qsrand(42);
+}
+
+void TestAutomaton::supports_data()
+{
+    QTest::addColumn<QString>("pattern");
+    QTest::addColumn<bool>("supported");
+
+    QTest::newRow("classes") << "\\d[-\\d ]{4,}\\d" << true;
+    QTest::newRow("word boundary") << "\\bfo+\\w*" << true;
+    QTest::newRow("lazy") << "(x|xy)*?z" << true;
+    QTest::newRow("lookahead") << "a(?!b)|ab?c" << true;
+    QTest::newRow("lookbehind") << "(?<=ab|cd)\\w" << true;
+    QTest::newRow("anchors") << "^ab|b$" << true;
+    QTest::newRow("backreference") << "(a)\\1" << false;
+    QTest::newRow("unbounded lookahead") << "a(?=\\w*b)" << false;
+    QTest::newRow("invalid") << "a(" << false;
+}
+
+void TestAutomaton::supports()
+{
+    QFETCH(QString, pattern);
+    QFETCH(bool, supported);
+    QCOMPARE(Automaton::supports(pattern), supported);
+}
+
+void TestAutomaton::equivalence_data()
+{
+    QTest::addColumn<QStringList>("patterns");
+
+    QTest::newRow("assertions")
+        << (QStringList() << "\\bfo+\\w*" << "(?<=x)ab(?=c)"
+                          << "(?<![a-z])q[^\\s]*?z" << "a(?!b)|ab?c");
+    QTest::newRow("alternatives")
+        << (QStringList() << "(x|xy)*?z" << "a{2,4}?b|a+"
+                          << "(?:ab|a)(?=c)c?" << "(a|ab)(c|bcd)(d*)");
+    QTest::newRow("anchors")
+        << (QStringList() << "^ab|b$" << ".a." << "[^a]{2}" << "\\B\\d+" << "\\d+$"
+                          << QString::fromUtf8("\xf0\x9f\x98\x80+a?")
+                          << QString::fromUtf8("(?<=\xf0\x9f\x98\x80)b")
+                          << "(?<=ab|cd)\\w");
+    QTest::newRow("empty matches")
+        << (QStringList() << "(a+)+b" << "(a|a)*c" << "\\W\\S\\D" << "x*" << "(?=a)|b");
+}
+
+void TestAutomaton::equivalence()
+{
+    QFETCH(QStringList, patterns);
+
+    HighlightScanner regexp = masterScanner(patterns);
+    QVERIFY(regexp.master.isValid());
+    Automaton automaton(patterns);
+    QVERIFY(automaton.isValid());
+
+    int matches = 0;
+    for (int round = 0; round < 2000; ++round) {
+        QString text = randomText(qrand() % 30);
+        int pos = 0;
+        while (pos <= text.length()) {
+            int start, length, expectedStart, expectedLength;
+            int expected = regexp.next(text, pos, &expectedStart, &expectedLength);
+            int found = automaton.next(text, pos, &start, &length);
+            if (found != expected)
+                qDebug() << text << pos;
+            QCOMPARE(found, expected);
+            if (found == -1)
+                break;
+            QCOMPARE(start, expectedStart);
+            QCOMPARE(length, expectedLength);
+            pos = start + qMax(length, 1);
+            ++matches;
+        }
+    }
+    QVERIFY(matches > 1000);
+}
+
+void TestAutomaton::catastrophic()
+{
+    // Regexps which make a backtracking matcher take exponential time are
+    // matched in linear time.
+    Automaton automaton(QStringList() << "(a+)+b" << "(a|aa)*c");
+    QVERIFY(automaton.isValid());
+    const QString text = QString(20000, 'a') + 'd';
+    QElapsedTimer timer;
+    timer.start();
+    int start, length;
+    QCOMPARE(automaton.next(text, 0, &start, &length), -1);
+    QVERIFY(timer.elapsed() < 5000);
+
+    QCOMPARE(automaton.next(QString(20000, 'a') + 'c', 0, &start, &length), 1);
+    QCOMPARE(start, 0);
+    QCOMPARE(length, 20001);
+}
+
+void TestAutomaton::longPartialMatches()
+{
+    // A search starts threads at all the positions in one pass, instead of
+    // trying the regexps again at each position, which would take minutes
+    // for texts in which a match could start anywhere but fails at the end.
+    Automaton automaton(QStringList() << "[a-z]+@[a-z]+" << "\\d{3,}\\.(?=x)");
+    QVERIFY(automaton.isValid());
+    QElapsedTimer timer;
+    timer.start();
+    int start, length;
+    QCOMPARE(automaton.next(QString(200000, 'a'), 0, &start, &length), -1);
+    QCOMPARE(automaton.next(QString(200000, '1') + ".y", 0, &start, &length), -1);
+    QCOMPARE(automaton.next(QString(200000, 'a') + "@b", 0, &start, &length), 0);
+    QCOMPARE(start, 0);
+    QCOMPARE(length, 200002);
+    QVERIFY2(timer.elapsed() < 2000, QByteArray::number(timer.elapsed()));
+}
+
+void TestAutomaton::backends()
+{
+    // Each pattern goes to the fastest engine which supports it, and the
+    // backends together find the same matches as the master regexp.
+    const QStringList patterns = QStringList()
+        << "\\b(\\w)\\w*\\1\\b"
+        << QString::fromUtf8(generatedScanners().first()->pattern)
+        << "\\bfo+\\w*"
+        << "(a|ab)(c|bcd)(d*)";
+    HighlightScanner regexp = masterScanner(patterns);
+    HighlightScanner mixed = regexp;
+    mixed.backends = createBackends(patterns);
+    QCOMPARE(mixed.backends.size(), 3);
+    QCOMPARE(mixed.backends[0]->engine(), ContentAction::GeneratedEngine);
+    QCOMPARE(mixed.backends[0]->categories(), QList<int>() << 1);
+    QCOMPARE(mixed.backends[1]->engine(), ContentAction::AutomatonEngine);
+    QCOMPARE(mixed.backends[1]->categories(), QList<int>() << 2 << 3);
+    QCOMPARE(mixed.backends[2]->engine(), ContentAction::BacktrackingEngine);
+    QCOMPARE(mixed.backends[2]->categories(), QList<int>() << 0);
+
+    for (int round = 0; round < 1000; ++round) {
+        QString text = randomText(qrand() % 40);
+        int pos = 0;
+        while (pos <= text.length()) {
+            int start, length, expectedStart, expectedLength;
+            int expected = regexp.next(text, pos, &expectedStart, &expectedLength);
+            int found = mixed.next(text, pos, &start, &length);
+            QCOMPARE(found, expected);
+            if (found == -1)
+                break;
+            QCOMPARE(start, expectedStart);
+            QCOMPARE(length, expectedLength);
+            pos = start + qMax(length, 1);
+        }
+    }
+}
+
+void TestAutomaton::reuse()
+{
+    // The backends of an engine whose patterns stay the same are reused,
+    // for the categories they now have.
+    const QStringList patterns = QStringList()
+        << "\\b(\\w)\\w*\\1\\b"
+        << QString::fromUtf8(generatedScanners().first()->pattern)
+        << "\\bfo+\\w*";
+    QList<QSharedPointer<const HighlightBackend> > backends = createBackends(patterns);
+    QCOMPARE(backends.size(), 3);
+
+    QList<QSharedPointer<const HighlightBackend> > same = createBackends(patterns, backends);
+    QCOMPARE(same.size(), 3);
+    QVERIFY(same[1] == backends[1]);
+    QVERIFY(same[2] == backends[2]);
+
+    QList<QSharedPointer<const HighlightBackend> > fewer =
+        createBackends(patterns.mid(1), backends);
+    QCOMPARE(fewer.size(), 2);
+    QCOMPARE(fewer[1]->engine(), ContentAction::AutomatonEngine);
+    QCOMPARE(fewer[1]->categories(), QList<int>() << 1);
+    QCOMPARE(fewer[1]->patterns(), backends[1]->patterns());
+    int start, length;
+    QCOMPARE(fewer[1]->next("a foo", 0, &start, &length), 0);
+    QCOMPARE(start, 2);
+    QCOMPARE(length, 3);
+}
+
+QTEST_MAIN(TestAutomaton)
+#include "test-automaton.moc"
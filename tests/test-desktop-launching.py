@@ -64,6 +64,28 @@ class Launching(unittest.TestCase):
         self.assertTrue(status == 0)
         self.assertTrue(content.find("'param1' 'param2' 'param3'") != -1)
 
+    def testDBusActivatable(self):
+        # a running instance gets the URIs over D-Bus
+        program = CLTool("uberprogram.py", "org.example.Activatable")
+        self.assertTrue(program.expect("started"))
+        (status, output) = getstatusoutput("lca-tool --triggerdesktop org.example.Activatable.desktop file:///tmp/a file:///tmp/b")
+        self.assertTrue(status == 0)
+        self.assertTrue(program.expect("Open: file:///tmp/a file:///tmp/b"))
+        (status, output) = getstatusoutput("lca-tool --triggerdesktop org.example.Activatable.desktop")
+        self.assertTrue(status == 0)
+        self.assertTrue(program.expect("Activate"))
+        program.kill()
+
+    def testDBusActivatableFallback(self):
+        # nobody owns the name, so the Exec line is used
+        (status, output) = getstatusoutput("lca-tool --triggerdesktop org.example.Activatable.desktop param1")
+        f = open("/tmp/executedAction")
+        content = f.read()
+        f.close()
+        os.remove("/tmp/executedAction")
+        self.assertTrue(status == 0)
+        self.assertTrue(content.find("'param1'") != -1)
+
 def runTests():
     suite = unittest.TestLoader().loadTestsFromTestCase(Launching)
     result = unittest.TextTestRunner(verbosity=2).run(suite)
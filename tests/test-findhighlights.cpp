@@ -22,8 +22,12 @@
 // This test utilized the regexps in data/hl-examples.xml
 
 #include "contentaction.h"
+#include "highlight.h"
 
+#include <QAtomicInt>
+#include <QBuffer>
 #include <QObject>
+#include <QThreadPool>
 #include <QTest>
 #include <QDebug>
 
@@ -43,6 +47,16 @@ private Q_SLOTS:
     void noOverlap();
 
     void nextHighlight();
+    void categories();
+    void blocks();
+    void reader();
+    void parallel();
+    void budget();
+    void cache();
+    void batch();
+    void selectedCategories();
+    void utf8();
+    void keepOverlaps();
 };
 
 void TestFindHighlights::initTestCase()
@@ -139,5 +153,436 @@ void TestFindHighlights::nextHighlight()
 
 }
 
+void TestFindHighlights::categories()
+{
+    QString text = "see http://example.com/page or foobazX, foobarfoo and http://other.com";
+
+    // highlight() with options finds the same fragments as findHighlights(),
+    // in a single pass, and each gets the actions of the category which
+    // matched it and of the categories it is a special case of.
+    QList<QPair<int, int> > expected = Action::findHighlights(text);
+    QList<HighlightMatch> matches = Action::highlight(text, HighlightOptions());
+
+    QCOMPARE(matches.size(), expected.size());
+    QCOMPARE(matches.size(), 4);
+    for (int i = 0; i < matches.size(); ++i) {
+        QCOMPARE(matches[i].start, expected[i].first);
+        QCOMPARE(matches[i].end, expected[i].first + expected[i].second);
+    }
+
+    QStringList names;
+    Q_FOREACH (const Action& a, matches[0].applicableActions())
+        names << a.name();
+    QVERIFY(names.contains("special-browser"));
+    QVERIFY(names.contains("browser"));
+
+    QCOMPARE(matches[0].category, QString("x-maemo-highlight/special-url"));
+    QCOMPARE(matches[1].category, QString("x-maemo-highlight/special-1b"));
+    QCOMPARE(matches[2].category, QString("x-maemo-highlight/special-1a"));
+
+    QCOMPARE(matches[1].applicableActions().size(), 1);
+    QCOMPARE(matches[1].applicableActions()[0].name(), QString("regexpmatcher"));
+    QCOMPARE(matches[2].applicableActions().size(), 1);
+
+    names.clear();
+    Q_FOREACH (const Action& a, matches[3].applicableActions())
+        names << a.name();
+    QVERIFY(names.contains("browser"));
+    QVERIFY(!names.contains("special-browser"));
+
+    // The deprecated overload returns what each category matches on its own,
+    // overlapping matches included, grouped by category, with the actions
+    // created.
+    HighlightOptions options;
+    options.keepOverlaps = true;
+    const QList<HighlightMatch> all = Action::highlight(text, options);
+    QVERIFY(all.size() > matches.size());
+    const QList<Match> res = Action::highlight(text);
+    QCOMPARE(res.size(), all.size());
+    int match = 0;
+    Q_FOREACH (const QString& category, Internal::highlightScanner()->categories) {
+        Q_FOREACH (const HighlightMatch& m, all) {
+            if (m.category != category)
+                continue;
+            QCOMPARE(res[match].start, m.start);
+            QCOMPARE(res[match].end, m.end);
+            QCOMPARE(res[match].actions.size(), m.applicableActions().size());
+            ++match;
+        }
+    }
+    QCOMPARE(match, res.size());
+}
+
+void TestFindHighlights::blocks()
+{
+    QString text;
+    for (int i = 0; i < 100; ++i)
+        text += QString("line %1 with a foobar and a cat\n").arg(i);
+
+    BlockHighlighter highlighter;
+    highlighter.setText(text);
+    QCOMPARE(highlighter.blockCount(), 101);
+    QCOMPARE(highlighter.highlights(), Action::findHighlights(text));
+    QCOMPARE(highlighter.blockHighlights(3).size(), 2);
+
+    // Typing in the middle of the text only rescans the line and its
+    // neighbours.
+    int pos = text.indexOf("line 50");
+    highlighter.replace(pos, 0, "foo");
+    QCOMPARE(highlighter.highlights(), Action::findHighlights(highlighter.text()));
+    QVERIFY(highlighter.rescannedBlocks() <= 3);
+
+    // Joining and splitting lines
+    pos = highlighter.text().indexOf("line 60");
+    highlighter.replace(pos - 1, 1, " ");
+    QCOMPARE(highlighter.blockCount(), 100);
+    QCOMPARE(highlighter.highlights(), Action::findHighlights(highlighter.text()));
+    highlighter.replace(pos - 1, 1, "\n\ncatalog\n");
+    QCOMPARE(highlighter.blockCount(), 103);
+    QCOMPARE(highlighter.highlights(), Action::findHighlights(highlighter.text()));
+
+    // Removing everything
+    highlighter.replace(0, highlighter.text().length(), QString());
+    QCOMPARE(highlighter.blockCount(), 1);
+    QVERIFY(highlighter.highlights().isEmpty());
+}
+
+void TestFindHighlights::reader()
+{
+    // Long enough to be read in several chunks
+    QString text;
+    for (int i = 0; i < 5000; ++i)
+        text += QString("%1 foobar%2, a catalog and foo\n").arg(i).arg(i);
+    QByteArray data = text.toUtf8();
+    QBuffer buffer(&data);
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+
+    HighlightReader reader(&buffer, 64);
+    QList<QPair<int, int> > expected = Action::findHighlights(text);
+    QList<QPair<int, int> > res;
+    qint64 start;
+    QString fragment;
+    QString category;
+    while (reader.readNext(&start, &fragment, &category)) {
+        QCOMPARE(fragment, text.mid(start, fragment.length()));
+        QVERIFY(category.startsWith("x-maemo-highlight/"));
+        res << qMakePair(int(start), fragment.length());
+    }
+    QCOMPARE(res.size(), expected.size());
+    QCOMPARE(res, expected);
+    // no actions after the end of the text
+    QVERIFY(reader.actions().isEmpty());
+}
+
+void TestFindHighlights::parallel()
+{
+    // Long enough to be split into several chunks, with matches running
+    // over the chunk boundaries
+    QString text;
+    for (int i = 0; i < 20000; ++i)
+        text += QString("foo%1 catfoobar%2-").arg(i).arg(i % 3 ? " " : "");
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(4);
+    HighlightOptions options;
+    options.threadPool = &pool;
+
+    QList<QPair<int, int> > expected = Action::findHighlights(text);
+    QVERIFY(!expected.isEmpty());
+    QCOMPARE(Action::findHighlights(text, options), expected);
+
+    // Small texts are scanned sequentially
+    QCOMPARE(Action::findHighlights("a foo and a cat", options),
+             Action::findHighlights("a foo and a cat"));
+}
+
+void TestFindHighlights::budget()
+{
+    QString text;
+    for (int i = 0; i < 20000; ++i)
+        text += QString("foo%1 catfoobar%2-").arg(i).arg(i % 3 ? " " : "");
+    QList<QPair<int, int> > expected = Action::findHighlights(text);
+    QThreadPool pool;
+    pool.setMaxThreadCount(4);
+
+    // Without limits everything is found
+    HighlightOptions options;
+    bool truncated = true;
+    QCOMPARE(Action::findHighlights(text, options, &truncated), expected);
+    QVERIFY(!truncated);
+    options.timeout = 60000;
+    QCOMPARE(Action::highlight(text, options, &truncated).size(), expected.size());
+    QVERIFY(!truncated);
+    QCOMPARE(Action::findNextHighlight(text, 10, options, &truncated),
+             Action::findNextHighlight(text, 10));
+    QVERIFY(!truncated);
+
+    // A cancelled scan stops before finding anything
+    QAtomicInt cancel(1);
+    options.cancel = &cancel;
+    QVERIFY(Action::findHighlights(text, options, &truncated).isEmpty());
+    QVERIFY(truncated);
+    QVERIFY(Action::highlight(text, options, &truncated).isEmpty());
+    QVERIFY(truncated);
+    QCOMPARE(Action::findNextHighlight(text, 0, options, &truncated),
+             qMakePair(-1, -1));
+    QVERIFY(truncated);
+    options.threadPool = &pool;
+    QVERIFY(Action::findHighlights(text, options, &truncated).isEmpty());
+    QVERIFY(truncated);
+
+    // What is found before the time runs out is the beginning of the
+    // complete result
+    options.cancel = 0;
+    options.timeout = 0;
+    for (int round = 0; round < 2; ++round) {
+        options.threadPool = round ? &pool : 0;
+        QList<QPair<int, int> > partial = Action::findHighlights(text, options, &truncated);
+        QVERIFY(partial.size() <= expected.size());
+        QCOMPARE(partial, expected.mid(0, partial.size()));
+        if (!truncated)
+            QCOMPARE(partial.size(), expected.size());
+    }
+
+    // With the overlaps kept, the matches of all the categories are found up
+    // to the same point of the text.
+    options.threadPool = 0;
+    options.keepOverlaps = true;
+    options.timeout = 60000;
+    const QList<QPair<int, int> > overlapping = Action::findHighlights(text, options);
+    QVERIFY(overlapping.size() > expected.size());
+    options.timeout = 0;
+    QList<QPair<int, int> > partial = Action::findHighlights(text, options, &truncated);
+    QVERIFY(partial.size() <= overlapping.size());
+    if (!partial.isEmpty()) {
+        int before = 0;
+        while (before < overlapping.size()
+               && overlapping[before].first < partial.last().first)
+            ++before;
+        QCOMPARE(partial.mid(0, before), overlapping.mid(0, before));
+    }
+}
+
+void TestFindHighlights::cache()
+{
+    const QString a("a foo and a cat"), b("foobar"), c("catfoo and dog");
+    QList<QPair<int, int> > expected = Action::findHighlights(a);
+    QList<HighlightMatch> matches = Action::highlight(a, HighlightOptions());
+    QVERIFY(!expected.isEmpty());
+
+    // Disabled by default
+    HighlightCacheStatistics stats = highlightCacheStatistics();
+    Action::findHighlights(a);
+    QCOMPARE(highlightCacheStatistics().hits, stats.hits);
+    QCOMPARE(highlightCacheStatistics().misses, stats.misses);
+    QCOMPARE(stats.entries, 0);
+
+    setHighlightCacheSize(2);
+    QCOMPARE(Action::findHighlights(a), expected);
+    QCOMPARE(highlightCacheStatistics().misses, stats.misses + 1);
+    QCOMPARE(Action::findHighlights(a), expected);
+    QCOMPARE(highlightCacheStatistics().hits, stats.hits + 1);
+
+    // The categories come from the cache too
+    QList<HighlightMatch> cached = Action::highlight(a, HighlightOptions());
+    QCOMPARE(highlightCacheStatistics().hits, stats.hits + 2);
+    QCOMPARE(cached.size(), matches.size());
+    for (int i = 0; i < cached.size(); ++i) {
+        QCOMPARE(cached[i].category, matches[i].category);
+        QCOMPARE(cached[i].start, matches[i].start);
+        QCOMPARE(cached[i].end, matches[i].end);
+    }
+
+    // The least recently used text is dropped
+    Action::findHighlights(b);
+    Action::findHighlights(c);
+    QCOMPARE(highlightCacheStatistics().entries, 2);
+    QCOMPARE(highlightCacheStatistics().misses, stats.misses + 3);
+    QCOMPARE(Action::findHighlights(a), expected);
+    QCOMPARE(highlightCacheStatistics().misses, stats.misses + 4);
+
+    // Results which were cut short are not kept
+    QAtomicInt cancel(1);
+    HighlightOptions options;
+    options.cancel = &cancel;
+    bool truncated;
+    QVERIFY(Action::findHighlights(b, options, &truncated).isEmpty());
+    QVERIFY(truncated);
+    QVERIFY(!Action::findHighlights(b).isEmpty());
+    QCOMPARE(highlightCacheStatistics().misses, stats.misses + 6);
+
+    // Scans of some of the categories are kept apart from the scans of all
+    setHighlightCacheSize(4);
+    HighlightOptions general;
+    general.categories << "x-maemo-highlight/general-2";
+    const QList<QPair<int, int> > some = Action::findHighlights(a, general);
+    QCOMPARE(some, QList<QPair<int, int> >() << qMakePair(12, 3));
+    QCOMPARE(Action::findHighlights(a), expected);
+    stats = highlightCacheStatistics();
+    QCOMPARE(Action::findHighlights(a, general), some);
+    QCOMPARE(Action::findHighlights(a), expected);
+    QCOMPARE(highlightCacheStatistics().hits, stats.hits + 2);
+    QCOMPARE(highlightCacheStatistics().misses, stats.misses);
+
+    setHighlightCacheSize(0);
+    QCOMPARE(highlightCacheStatistics().entries, 0);
+}
+
+void TestFindHighlights::batch()
+{
+    QStringList texts;
+    for (int i = 0; i < 6000; ++i)
+        texts << QString("message %1: foo%2 and catdog or foobar%3").arg(i).arg(i).arg(i % 7);
+    texts << QString() << "nothing here";
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(4);
+    HighlightOptions options;
+    for (int round = 0; round < 2; ++round) {
+        options.threadPool = round ? &pool : 0;
+        bool truncated = true;
+        HighlightBatch batch = Action::findHighlights(texts, options, &truncated);
+        QVERIFY(!truncated);
+        QCOMPARE(batch.start.size(), batch.text.size());
+        QCOMPARE(batch.length.size(), batch.text.size());
+        QCOMPARE(batch.category.size(), batch.text.size());
+
+        // The same matches as highlighting each text on its own
+        int match = 0;
+        for (int i = 0; i < texts.size(); ++i) {
+            Q_FOREACH (const HighlightMatch& m, Action::highlight(texts[i], HighlightOptions())) {
+                QVERIFY(match < batch.text.size());
+                QCOMPARE(batch.text[match], i);
+                QCOMPARE(batch.start[match], m.start);
+                QCOMPARE(batch.length[match], m.end - m.start);
+                QCOMPARE(batch.categories[batch.category[match]], m.category);
+                ++match;
+            }
+        }
+        QCOMPARE(match, batch.text.size());
+    }
+
+    QAtomicInt cancel(1);
+    options.cancel = &cancel;
+    bool truncated = false;
+    QVERIFY(Action::findHighlights(texts, options, &truncated).text.isEmpty());
+    QVERIFY(truncated);
+}
+
+void TestFindHighlights::selectedCategories()
+{
+    typedef QList<QPair<int, int> > Highlights;
+    const QString text("foobar catdog cat foo");
+    const QString general2("x-maemo-highlight/general-2");
+    HighlightOptions options;
+
+    // A general category matches also what its special cases would have.
+    options.categories << general2;
+    QCOMPARE(Action::findHighlights(text, options),
+             Highlights() << qMakePair(7, 6) << qMakePair(14, 3));
+    QList<HighlightMatch> res = Action::highlight(text, options);
+    QCOMPARE(res.size(), 2);
+    QCOMPARE(res[0].category, general2);
+    QCOMPARE(res[1].category, general2);
+    HighlightBatch batch = Action::findHighlights(QStringList() << text << "cat", options);
+    QCOMPARE(batch.categories, QStringList(general2));
+    QCOMPARE(batch.text, QVector<int>() << 0 << 0 << 1);
+    QCOMPARE(Action::findNextHighlight(text, 0, options), qMakePair(7, 6));
+
+    // The matcher of the categories is kept.
+    QSharedPointer<const Internal::HighlightScanner> scanner =
+        Internal::highlightScanner(options.categories);
+    QCOMPARE(scanner->categories, QStringList(general2));
+    QVERIFY(Internal::highlightScanner(options.categories) == scanner);
+
+    // Subsets of a scanner are made from that scanner, like the single
+    // categories of a scan which keeps the overlaps.
+    const QSharedPointer<const Internal::HighlightScanner> pair =
+        Internal::highlightScanner(QStringList() << general2 << "x-maemo-highlight/special-2");
+    QCOMPARE(pair->categories.size(), 2);
+    const QSharedPointer<const Internal::HighlightScanner> single =
+        Internal::highlightScanner(*pair, QStringList(general2));
+    QCOMPARE(single->categories, QStringList(general2));
+    QVERIFY(single->generation > pair->generation);
+    QVERIFY(Internal::highlightScanner(*pair, QStringList(general2)) == single);
+    QVERIFY(!Internal::highlightScanner(*pair, pair->categories));
+
+    // A special case keeps the actions of its general category.
+    options.categories = QStringList("x-maemo-highlight/special-1a");
+    res = Action::highlight(text, options);
+    QCOMPARE(res.size(), 1);
+    QCOMPARE(res[0].start, 0);
+    QCOMPARE(res[0].end, 6);
+    QCOMPARE(res[0].applicableActions().size(), 1);
+    QCOMPARE(res[0].applicableActions()[0].name(), QString("regexpmatcher"));
+
+    // Unknown categories match nothing, and no categories match all.
+    options.categories = QStringList("x-maemo-highlight/none");
+    QVERIFY(Action::findHighlights(text, options).isEmpty());
+    options.categories.clear();
+    QCOMPARE(Action::findHighlights(text, options), Action::findHighlights(text));
+    QVERIFY(Internal::highlightScanner(options.categories) == Internal::highlightScanner());
+}
+
+void TestFindHighlights::utf8()
+{
+    const QString text = QString::fromUtf8(
+        "\xc3\xa9 foo\xe2\x82\xac catdog \xf0\x9f\x98\x80" "foobar and cat\xf0\x9f\x98\x80");
+    const QByteArray bytes = text.toUtf8();
+    QList<QPair<int, int> > expected = Action::findHighlights(text);
+    QVERIFY(expected.size() >= 3);
+
+    QList<QPair<int, int> > utf16;
+    QList<QPair<int, int> > found = Action::findHighlightsUtf8(bytes, &utf16);
+    QCOMPARE(utf16, expected);
+    QCOMPARE(found.size(), expected.size());
+    for (int i = 0; i < found.size(); ++i)
+        QCOMPARE(QString::fromUtf8(bytes.mid(found[i].first, found[i].second)),
+                 text.mid(expected[i].first, expected[i].second));
+
+    QList<HighlightMatch> matches = Action::highlight(text, HighlightOptions());
+    QList<HighlightMatch> utf8Matches = Action::highlightUtf8(bytes);
+    QCOMPARE(utf8Matches.size(), matches.size());
+    for (int i = 0; i < matches.size(); ++i) {
+        QCOMPARE(utf8Matches[i].category, matches[i].category);
+        QCOMPARE(utf8Matches[i].start, found[i].first);
+        QCOMPARE(utf8Matches[i].end, found[i].first + found[i].second);
+    }
+
+    // Invalid bytes are characters of their own
+    QByteArray invalid = QByteArray("\xff") + "foo" + "\xc3";
+    found = Action::findHighlightsUtf8(invalid, &utf16);
+    QCOMPARE(found.size(), 1);
+    QCOMPARE(found[0], qMakePair(1, 3));
+    QCOMPARE(utf16[0], qMakePair(1, 3));
+}
+
+void TestFindHighlights::keepOverlaps()
+{
+    typedef QList<QPair<int, int> > Highlights;
+    const QString text("catdogzebra foo");
+    QCOMPARE(Action::findHighlights(text),
+             Highlights() << qMakePair(0, 11) << qMakePair(12, 3));
+
+    // Every category matches the text on its own, the special cases first.
+    HighlightOptions options;
+    options.keepOverlaps = true;
+    QCOMPARE(Action::findHighlights(text, options),
+             Highlights() << qMakePair(0, 11) << qMakePair(0, 11) << qMakePair(0, 11)
+                          << qMakePair(12, 3));
+    HighlightBatch batch = Action::findHighlights(QStringList(text), options);
+    QCOMPARE(batch.category.size(), 4);
+    QCOMPARE(batch.categories[batch.category[0]],
+             QString("x-maemo-highlight/superspecial-2"));
+    QCOMPARE(batch.categories[batch.category[1]], QString("x-maemo-highlight/special-2"));
+    QCOMPARE(batch.categories[batch.category[2]], QString("x-maemo-highlight/general-2"));
+    QCOMPARE(batch.categories[batch.category[3]], QString("x-maemo-highlight/general-1"));
+    QList<HighlightMatch> res = Action::highlight(text, options);
+    QCOMPARE(res.size(), 4);
+
+    // The cached result without the overlaps is not affected.
+    QCOMPARE(Action::findHighlights(text).size(), 2);
+}
+
 QTEST_MAIN(TestFindHighlights)
 #include "test-findhighlights.moc"
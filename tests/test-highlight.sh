@@ -6,12 +6,24 @@ srcdir=.
 
 export CONTENTACTION_ACTIONS=/usr/share/contentaction
 
+# The rules are loaded from the table generated at build time.
+[ -r $CONTENTACTION_ACTIONS/highlight1.hltable ] || exit 5
+
 strstr() {
     expr "$1" : "$2" >/dev/null;
 }
 
 res=$(lca-tool --highlight < $srcdir/hlinput.txt)
 
+# Without the table, the same rules are read from the XML.
+xmldir=$(mktemp -d)
+cp $CONTENTACTION_ACTIONS/*.xml $xmldir/
+xmlres=$(CONTENTACTION_ACTIONS=$xmldir lca-tool --highlight < $srcdir/hlinput.txt)
+xmlengines=$(CONTENTACTION_ACTIONS=$xmldir lca-tool --highlightengines)
+rm -r $xmldir
+[ "$xmlres" = "$res" ] || exit 6
+[ "$xmlengines" = "$(lca-tool --highlightengines)" ] || exit 7
+
 strstr "$res" ".*61 73 '+44 433 2236' caller" || exit 10
 strstr "$res" ".*77 80 '911' caller" || exit 11
 strstr "$res" ".*15 33 'email@address.here' emailer" || exit 12
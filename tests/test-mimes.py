@@ -20,6 +20,7 @@
 
 import sys
 import os
+import re
 # Otherwise env.py won't be found when running tests inside a VPATH build dir
 sys.path.insert(0, os.getcwd())
 
@@ -63,7 +64,19 @@ class Mimes(unittest.TestCase):
         (status, output) = getstatusoutput("lca-tool --file --trigger ubermimeopen " + filename)
         self.assertTrue(status == 0)
 
-        self.assertTrue(program.expect("mime_open:"))
+        # the URI arrives as an argument of mime_open
+        self.assertTrue(program.expect("mime_open: .*" + re.escape(filename)))
+        program.kill()
+
+    def testMimeOpenArguments(self):
+        program = CLTool("uberprogram.py")
+        self.assertTrue(program.expect("started"))
+
+        (status, output) = getstatusoutput("lca-tool --triggerdesktop ubermimeopen.desktop param1 param2")
+        self.assertTrue(status == 0)
+
+        # each param is a separate argument of mime_open
+        self.assertTrue(program.expect("mime_open: .*'param1'.*'param2'"))
         program.kill()
 
     def testInvokeExec(self):
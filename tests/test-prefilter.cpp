@@ -0,0 +1,275 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+// Tests the analysis of the highlighter regexps, and that scanning only the
+// windows found by the prefilter gives the same matches as scanning all of
+// the text.
+
+#include "highlight.h"
+#include "prefilter.h"
+
+#include <QObject>
+#include <QTest>
+#include <QDebug>
+
+using namespace ContentAction::Internal;
+
+namespace {
+
+// Some of the regexps of highlight1.xml, and ones with lookarounds.
+const char *const Patterns[] = {
+    "([mM][aA][iI][lL][tT][oO]:)?[a-zA-Z0-9_!#$%&'*+/=?^`{|}~-]+(\\.[a-zA-Z0-9_!#$%&'*+/=?^`{|}~-]+)*@([a-zA-Z0-9_-]+\\.)+[a-zA-Z0-9_-]+",
+    "((([cC][aA][lL][lL][tT][oO]:)|([sS][mM][sS]:)|([tT][eE][lL]:))?)(([+#*] ?)?)(((\\d\\d\\d+[.])|(\\(\\d+\\) ?)|(\\d[-pwxPWX#* ]*)){2,19})([0-9-#*])((?!\\d))",
+    "[fF][tT][pP]://([a-zA-Z0-9_]+((:[a-zA-Z0-9_]+)?)@)?([a-zA-Z0-9_\\-]+\\.)+[a-zA-Z0-9_\\-]+(:\\d+)?(/([a-zA-Z0-9_/?%:;@&=+$,\\-.!~*'#]*[a-zA-Z0-9_/?%:;@&=+$,\\-!~*'#]|\\([a-zA-Z0-9_/?%:;@&=+$,\\-.!~*'#]*\\))*)?",
+    "[sS][iI][pP][sS]?:[a-zA-Z0-9_/?%:;@&=+$,\\-.!~*'#]*",
+    "\\bfo+\\w*",
+    "(?<=x)ab(?=c)",
+    "(?<![a-z])q[^\\s]*?z"
+};
+
+// Pieces of text which make matches likely
+const char *const Pieces[] = {
+    "a", "b", "c", "f", "o", "q", "x", "z", " ", " ", "\n", ".", ",", "@", "1",
+    "5", "0", "-", "(", ")", "+", "#", "/", ":", "ftp://", "sip:", "tel:",
+    "mailto:", "foo", "xabc", "example.com", "user@host.org", "555-1234", "?",
+    "&", "'", "\xc3\xa9", "\xf0\x9f\x98\x80"
+};
+
+HighlightScanner scannerFor(const QStringList& patterns, bool filtered)
+{
+    HighlightScanner scanner;
+    QString re("(?:");
+    int group = 1;
+    Q_FOREACH (const QString& pattern, patterns) {
+        if (group > 1)
+            re += '|';
+        re += '(' + pattern + ')';
+        scanner.categories << pattern;
+        scanner.mimeTypes << QStringList();
+        scanner.groups << group;
+        group += 1 + QRegularExpression(pattern).captureCount();
+    }
+    re += ")";
+    scanner.master = QRegularExpression(re);
+    if (filtered)
+        scanner.prefilter = Prefilter(patterns);
+    return scanner;
+}
+
+QList<QPair<int, int> > scan(const HighlightScanner& scanner, const QString& text)
+{
+    QList<QPair<int, int> > result;
+    HighlightCursor cursor(scanner, text);
+    int start, length, category;
+    while ((category = cursor.next(&start, &length)) != -1)
+        result << qMakePair(start, category * 100000 + length);
+    return result;
+}
+
+QString randomText(int pieces)
+{
+    const int count = sizeof(Pieces) / sizeof(*Pieces);
+    QString text;
+    for (int i = 0; i < pieces; ++i)
+        text += QString::fromUtf8(Pieces[qrand() % count]);
+    return text;
+}
+
+} // end anon namespace
+
+class TestPrefilter : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void charSet();
+    void parse();
+    void unsupported();
+    void anchors();
+    void windows();
+    void equivalence();
+};
+
+void TestPrefilter::initTestCase()
+{
+    qsrand(38);
+}
+
+void TestPrefilter::charSet()
+{
+    CharSet set;
+    set.add('a', 'f');
+    set.add('d', 'k');
+    set.add('l');
+    set.add('0', '9');
+    QCOMPARE(set.toRanges().size(), 2);
+    QCOMPARE(set.size(), 22);
+    QVERIFY(set.contains('l'));
+    QVERIFY(!set.contains('m'));
+    QCOMPARE(set.negated().size(), 0x10000 - 22);
+    QCOMPARE(set.negated().negated(), set);
+}
+
+void TestPrefilter::parse()
+{
+    const int count = sizeof(Patterns) / sizeof(*Patterns);
+    for (int i = 0; i < count; ++i) {
+        PatternNode root;
+        int captures = -1;
+        QVERIFY2(parsePattern(Patterns[i], &root, &captures), Patterns[i]);
+        QCOMPARE(captures, QRegularExpression(Patterns[i]).captureCount());
+        CharSet required;
+        QVERIFY(requiredChars(root, &required));
+        QVERIFY(!isAnchored(root));
+    }
+
+    // The anchor of an email address is the rare '@', not a letter.
+    PatternNode root;
+    CharSet required;
+    QVERIFY(parsePattern(Patterns[0], &root));
+    QVERIFY(requiredChars(root, &required));
+    CharSet at;
+    at.add('@');
+    QCOMPARE(required, at);
+    QVERIFY(!consumableChars(root).contains(' '));
+
+    // Lookarounds don't consume anything, but make the regexps look around
+    // the match.
+    QVERIFY(parsePattern("(?<=x)ab(?=c)", &root));
+    QCOMPARE(lookaroundLength(root), 1);
+    QVERIFY(!consumableChars(root).contains('x'));
+    QVERIFY(parsePattern("a(?=bcd)", &root));
+    QCOMPARE(lookaroundLength(root), 3);
+    QCOMPARE(maximumLength(root), 1);
+    QVERIFY(parsePattern("a\\b", &root));
+    QCOMPARE(lookaroundLength(root), 1);
+}
+
+void TestPrefilter::unsupported()
+{
+    // Syntax which is not understood disables the prefilter.
+    QStringList patterns;
+    patterns << "(a)\\1" << "(?i)abc" << "a++" << "\\p{L}+" << "[[:alpha:]]"
+             << "\\Qa.b\\E" << "(?>ab)" << "a(";
+    Q_FOREACH (const QString& pattern, patterns) {
+        PatternNode root;
+        QVERIFY2(!parsePattern(pattern, &root), qPrintable(pattern));
+        QVERIFY(!Prefilter(QStringList() << "abc" << pattern).isEnabled());
+    }
+
+    // So does a regexp which can match the empty string, is anchored or
+    // looks too far.
+    patterns.clear();
+    patterns << "a*" << "(ab)?" << "^abc" << "abc$" << "a(?=b+)" << "a(?!.{20})";
+    Q_FOREACH (const QString& pattern, patterns) {
+        PatternNode root;
+        QVERIFY2(parsePattern(pattern, &root), qPrintable(pattern));
+        QVERIFY2(!Prefilter(QStringList() << "abc" << pattern).isEnabled(),
+                 qPrintable(pattern));
+    }
+
+    QVERIFY(Prefilter(QStringList() << "abc" << "a{2,}b").isEnabled());
+    QVERIFY(!Prefilter().isEnabled());
+}
+
+void TestPrefilter::anchors()
+{
+    // The vectorised search finds the same positions as the scalar one, for
+    // sets of a few ranges and for sets of many.
+    for (int round = 0; round < 500; ++round) {
+        CharSet set;
+        const int ranges = qrand() % 12;
+        for (int i = 0; i < ranges; ++i) {
+            ushort first = qrand() % 3 ? qrand() % 128 : qrand() % 0x10000;
+            set.add(first, qMin(0xffff, first + qrand() % 200));
+        }
+        QVector<ushort> text(qrand() % 100);
+        for (int i = 0; i < text.size(); ++i)
+            text[i] = qrand() % 4 ? qrand() % 128 : qrand() % 0x10000;
+
+        QVector<int> scalar, vector;
+        findAnchors(text.constData(), text.size(), set, &scalar, ScalarSearch);
+        findAnchors(text.constData(), text.size(), set, &vector, VectorSearch);
+        QCOMPARE(vector, scalar);
+
+        int next = 0;
+        for (int i = 0; i < text.size(); ++i) {
+            if (set.contains(text[i])) {
+                QVERIFY(next < scalar.size());
+                QCOMPARE(scalar[next++], i);
+            }
+        }
+        QCOMPARE(next, scalar.size());
+    }
+}
+
+void TestPrefilter::windows()
+{
+    QStringList patterns;
+    patterns << Patterns[0];
+    Prefilter prefilter(patterns);
+    QVERIFY(prefilter.isEnabled());
+
+    // Only the words around the '@' are worth matching.
+    QString text("write to foo@example.com or bar@example.org soon");
+    QVector<QPair<int, int> > windows = prefilter.windows(text);
+    QCOMPARE(windows.size(), 2);
+    QCOMPARE(text.mid(windows[0].first, windows[0].second - windows[0].first),
+             QString("foo@example.com"));
+    QCOMPARE(text.mid(windows[1].first, windows[1].second - windows[1].first),
+             QString("bar@example.org"));
+    QCOMPARE(windows, prefilter.windows(text, ScalarSearch));
+
+    QVERIFY(prefilter.windows("no addresses here").isEmpty());
+}
+
+void TestPrefilter::equivalence()
+{
+    QStringList patterns;
+    const int count = sizeof(Patterns) / sizeof(*Patterns);
+    for (int i = 0; i < count; ++i)
+        patterns << Patterns[i];
+    const HighlightScanner filtered = scannerFor(patterns, true);
+    const HighlightScanner unfiltered = scannerFor(patterns, false);
+    QVERIFY(filtered.prefilter.isEnabled());
+    QVERIFY(!unfiltered.prefilter.isEnabled());
+
+    int matches = 0;
+    for (int round = 0; round < 2000; ++round) {
+        QString text = randomText(qrand() % 80);
+        QList<QPair<int, int> > expected = scan(unfiltered, text);
+        QList<QPair<int, int> > res = scan(filtered, text);
+        if (res != expected)
+            qDebug() << "text:" << text;
+        QCOMPARE(res, expected);
+        matches += expected.size();
+    }
+    QVERIFY(matches > 1000);
+
+    // A long text with few matches
+    QString text(100000, QChar(' '));
+    text.replace(500, 16, "mail foo@bar.com");
+    text.replace(70000, 17, "call 555-1234 now");
+    QCOMPARE(scan(filtered, text), scan(unfiltered, text));
+    QCOMPARE(scan(filtered, text).size(), 2);
+}
+
+QTEST_MAIN(TestPrefilter)
+#include "test-prefilter.moc"
@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "regexpcache.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QObject>
+#include <QRegularExpression>
+#include <QTemporaryDir>
+#include <QTest>
+
+using namespace ContentAction::Internal;
+
+namespace {
+
+const char *const Pattern =
+    "(?:(([mM][aA][iI][lL][tT][oO]:)?[a-zA-Z0-9_.-]+@([a-zA-Z0-9_-]+\\.)+[a-zA-Z0-9_-]+)"
+    "|(\\d[-\\d ]{4,}\\d(?!\\d)))";
+
+} // end anon namespace
+
+class TestRegexpCache : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void cache();
+    void invalidated();
+    void matching();
+    void limits();
+};
+
+void TestRegexpCache::cache()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    // The first process compiles and stores the regexp, the next ones load
+    // it.
+    CompiledRegexp first(Pattern, dir.path());
+    QVERIFY(first.isValid());
+    QCOMPARE(first.source(), CompiledRegexp::Compiled);
+    QVERIFY(QFile::exists(first.cacheFile()));
+
+    CompiledRegexp second(Pattern, dir.path());
+    QVERIFY(second.isValid());
+    QCOMPARE(second.source(), CompiledRegexp::Cached);
+    QCOMPARE(second.cacheFile(), first.cacheFile());
+
+    // Another pattern has another key, and its file replaces the stale one,
+    // but not the files of other versions of the library.
+    QVERIFY(QDir(dir.path()).mkdir("other-version"));
+    const QString otherVersion = dir.path() + "/other-version/highlight-0.pcre2";
+    QVERIFY(QFile(otherVersion).open(QIODevice::WriteOnly));
+    CompiledRegexp other("foo\\w*", dir.path());
+    QCOMPARE(other.source(), CompiledRegexp::Compiled);
+    QVERIFY(other.cacheFile() != first.cacheFile());
+    QVERIFY(QFile::exists(other.cacheFile()));
+    QVERIFY(!QFile::exists(first.cacheFile()));
+    QVERIFY(QFile::exists(otherVersion));
+
+    // Regexps which are not to be cached leave the cache alone.
+    CompiledRegexp uncached(Pattern, dir.path(), CompiledRegexp::NoCache);
+    QVERIFY(uncached.isValid());
+    QCOMPARE(uncached.source(), CompiledRegexp::Compiled);
+    QVERIFY(uncached.cacheFile().isEmpty());
+    QVERIFY(QFile::exists(other.cacheFile()));
+    QCOMPARE(QFileInfo(other.cacheFile()).dir().entryList(QDir::Files).size(), 1);
+
+    // Invalid patterns are not cached.
+    CompiledRegexp invalid("a(", dir.path());
+    QVERIFY(!invalid.isValid());
+    QCOMPARE(invalid.source(), CompiledRegexp::Invalid);
+    QVERIFY(!QFile::exists(invalid.cacheFile()));
+}
+
+void TestRegexpCache::invalidated()
+{
+    QTemporaryDir dir;
+    QString file = CompiledRegexp(Pattern, dir.path()).cacheFile();
+
+    // A broken cache file is compiled over.
+    QFile f(file);
+    QVERIFY(f.open(QIODevice::ReadWrite));
+    QByteArray data = f.readAll();
+    f.resize(data.size() / 2);
+    f.close();
+    CompiledRegexp truncated(Pattern, dir.path());
+    QVERIFY(truncated.isValid());
+    QCOMPARE(truncated.source(), CompiledRegexp::Compiled);
+    QCOMPARE(CompiledRegexp(Pattern, dir.path()).source(), CompiledRegexp::Cached);
+
+    QVERIFY(f.open(QIODevice::ReadWrite));
+    data = f.readAll();
+    data[data.size() - 1] = data[data.size() - 1] ^ 1;
+    f.seek(0);
+    f.write(data);
+    f.close();
+    QCOMPARE(CompiledRegexp(Pattern, dir.path()).source(), CompiledRegexp::Compiled);
+}
+
+void TestRegexpCache::matching()
+{
+    QTemporaryDir dir;
+    CompiledRegexp compiled(Pattern, dir.path());
+    CompiledRegexp cached(Pattern, dir.path());
+    QCOMPARE(cached.source(), CompiledRegexp::Cached);
+    QRegularExpression reference(Pattern);
+
+    const QString text = QString::fromUtf8(
+        "mail mailto:foo@example.com or call 555-1234 or 12 34, "
+        "bar.baz@host.org\xc3\xa9 \xf0\x9f\x98\x80 123456");
+    int pos = 0;
+    int matches = 0;
+    while (true) {
+        QRegularExpressionMatch expected = reference.match(text, pos);
+        QVector<int> a, b;
+        QCOMPARE(compiled.match(text, pos, &a), expected.hasMatch());
+        QCOMPARE(cached.match(text, pos, &b), expected.hasMatch());
+        if (!expected.hasMatch())
+            break;
+        QCOMPARE(a, b);
+        for (int group = 0; group <= reference.captureCount(); ++group) {
+            QCOMPARE(a[2 * group], expected.capturedStart(group));
+            QCOMPARE(a[2 * group + 1], expected.capturedEnd(group));
+        }
+        pos = expected.capturedEnd();
+        ++matches;
+    }
+    QCOMPARE(matches, 4);
+}
+
+void TestRegexpCache::limits()
+{
+    // A regexp which backtracks catastrophically gives up instead of
+    // running for ages; a sane one still matches.
+    CompiledRegexp catastrophic("(a|aa)+(\\1)b");
+    QVERIFY(catastrophic.isValid());
+    catastrophic.setLimits(1000, 10, 0, 1000);
+    const QString text = QString(40, 'a') + "cb";
+    QVector<int> captures;
+    CompiledRegexp::Failure failure = CompiledRegexp::NoFailure;
+    QVERIFY(!catastrophic.match(text, 0, &captures, &failure));
+    QCOMPARE(failure, CompiledRegexp::LimitReached);
+
+    // The limit which grows with the text is capped.
+    catastrophic.setLimits(1000, 1000000, 2000, 0);
+    failure = CompiledRegexp::NoFailure;
+    QVERIFY(!catastrophic.match(text, 0, &captures, &failure));
+    QCOMPARE(failure, CompiledRegexp::LimitReached);
+
+    CompiledRegexp sane(Pattern);
+    sane.setLimits(1000, 10, 0, 1000);
+    QVERIFY(sane.match("call 555-1234", 0, &captures, &failure));
+    QCOMPARE(failure, CompiledRegexp::NoFailure);
+    QCOMPARE(captures[0], 5);
+    QVERIFY(!sane.match("nothing", 0, &captures, &failure));
+    QCOMPARE(failure, CompiledRegexp::NoFailure);
+}
+
+QTEST_MAIN(TestRegexpCache)
+#include "test-regexpcache.moc"
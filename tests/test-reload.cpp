@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+// Checks that the highlighter picks up changes to its configuration files,
+// and to the applications which handle its categories, while the
+// application is running.
+
+#include "contentaction.h"
+#include "highlight.h"
+
+#include <QBuffer>
+#include <QDir>
+#include <QFile>
+#include <QObject>
+#include <QTemporaryDir>
+#include <QTest>
+#include <QDebug>
+
+using namespace ContentAction;
+
+typedef QList<QPair<int, int> > Highlights;
+
+class TestReload : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void reload();
+    void associations();
+    void priorities();
+    void missingDirectory();
+
+private:
+    void writeFile(const QString& path, const QByteArray& content);
+    void writeRules(const QString& regexp, const QString& zork = QString());
+
+    QTemporaryDir dir;
+    QTemporaryDir home;
+};
+
+void TestReload::writeFile(const QString& path, const QByteArray& content)
+{
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    file.write(content);
+}
+
+// Writes a configuration which highlights regexp as an ovoda, and zork, if
+// given, as a zork.
+void TestReload::writeRules(const QString& regexp, const QString& zork)
+{
+    QByteArray rules = "<actions>\n"
+        "  <highlight name=\"ovoda\" regexp=\"" + regexp.toUtf8() + "\"/>\n";
+    if (!zork.isEmpty())
+        rules += "  <highlight name=\"zork\" regexp=\"" + zork.toUtf8() + "\"/>\n";
+    rules += "</actions>\n";
+    writeFile(dir.path() + "/highlight.xml", rules);
+}
+
+void TestReload::initTestCase()
+{
+    QVERIFY(dir.isValid());
+    QVERIFY(home.isValid());
+    QVERIFY(QDir(home.path()).mkdir("applications"));
+    writeRules("ovoda\\w*");
+    qputenv("CONTENTACTION_ACTIONS", QFile::encodeName(dir.path()));
+    qputenv("XDG_DATA_HOME", QFile::encodeName(home.path()));
+}
+
+void TestReload::reload()
+{
+    const QString text("ovoda dodo");
+    QCOMPARE(Action::findHighlights(text), Highlights() << qMakePair(0, 5));
+    BlockHighlighter blocks;
+    blocks.setText(text);
+    QCOMPARE(blocks.highlights(), Highlights() << qMakePair(0, 5));
+    const QSharedPointer<const Internal::HighlightScanner> old =
+        Internal::highlightScanner();
+
+    writeRules("dodo\\w*");
+    QTRY_COMPARE(Action::findHighlights(text), Highlights() << qMakePair(6, 4));
+    QVERIFY(Internal::highlightScanner()->generation != old->generation);
+
+    // A scan which started before the reload goes on with the old rules.
+    int start, length;
+    QCOMPARE(old->next(text, 0, &start, &length), 0);
+    QCOMPARE(start, 0);
+    QCOMPARE(length, 5);
+
+    // The next edit rescans the whole text with the new rules.
+    blocks.replace(text.length(), 0, "\nx");
+    QCOMPARE(blocks.highlights(), Highlights() << qMakePair(6, 4));
+    QCOMPARE(blocks.rescannedBlocks(), 2);
+}
+
+void TestReload::associations()
+{
+    // Nothing handles zorks yet.
+    const int generation = Internal::highlightScanner()->generation;
+    writeRules("dodo\\w*", "zork\\w*");
+    const QString text("dodo zork");
+    QTRY_VERIFY(Internal::highlightScanner()->generation != generation);
+    QCOMPARE(Internal::highlightScanner()->categories.size(), 1);
+    QCOMPARE(Action::findHighlights(text), Highlights() << qMakePair(0, 4));
+
+    // An application which handles them is installed, and then removed.
+    const QString cache = home.path() + "/applications/mimeinfo.cache";
+    writeFile(cache, "[MIME Cache]\nx-maemo-highlight/zork=ovoda.desktop;\n");
+    QTRY_COMPARE(Action::findHighlights(text),
+                 Highlights() << qMakePair(0, 4) << qMakePair(5, 4));
+    QVERIFY(QFile::remove(cache));
+    QTRY_COMPARE(Action::findHighlights(text), Highlights() << qMakePair(0, 4));
+}
+
+void TestReload::priorities()
+{
+    writeFile(home.path() + "/applications/mimeinfo.cache",
+              "[MIME Cache]\nx-maemo-highlight/zork=ovoda.desktop;\n");
+    const QByteArray ovoda = "  <highlight name=\"ovoda\" regexp=\"\\w+ \\w+\"/>\n";
+    writeFile(dir.path() + "/highlight.xml", "<actions>\n" + ovoda +
+              "  <highlight name=\"zork\" regexp=\"zork\\w*\"/>\n</actions>\n");
+    const QString text("dodo zork");
+    QTRY_COMPARE(Action::findHighlights(text), Highlights() << qMakePair(0, 9));
+    QVERIFY(!Internal::highlightScanner()->hasPriorities());
+
+    // Of the overlapping matches, the one of the higher priority wins.
+    writeFile(dir.path() + "/highlight.xml", "<actions>\n" + ovoda +
+              "  <highlight name=\"zork\" regexp=\"zork\\w*\" priority=\"1\"/>\n"
+              "</actions>\n");
+    QTRY_COMPARE(Action::findHighlights(text), Highlights() << qMakePair(5, 4));
+    QVERIFY(Internal::highlightScanner()->hasPriorities());
+    QCOMPARE(Action::findNextHighlight(text, 0), qMakePair(0, 9));
+
+    HighlightOptions options;
+    options.keepOverlaps = true;
+    QCOMPARE(Action::findHighlights(text, options),
+             Highlights() << qMakePair(0, 9) << qMakePair(5, 4));
+
+    // A match which is pushed out by one of a higher priority no longer
+    // keeps out the matches it overlapped.
+    writeFile(home.path() + "/applications/mimeinfo.cache",
+              "[MIME Cache]\nx-maemo-highlight/zork=ovoda.desktop;\n"
+              "x-maemo-highlight/kay=ovoda.desktop;\n"
+              "x-maemo-highlight/aa=ovoda.desktop;\n"
+              "x-maemo-highlight/hat=ovoda.desktop;\n");
+    writeFile(dir.path() + "/highlight.xml", "<actions>\n"
+              "  <highlight name=\"kay\" regexp=\"K[^K\\n]*K\"/>\n"
+              "  <highlight name=\"aa\" regexp=\"aa\"/>\n"
+              "  <highlight name=\"hat\" regexp=\"H[^H\\n]*H\" priority=\"5\"/>\n"
+              "</actions>\n");
+    const QString cascade("K.aa..H.K....H");
+    QTRY_COMPARE(Action::findHighlights(cascade),
+                 Highlights() << qMakePair(2, 2) << qMakePair(6, 8));
+
+    // The block highlighter selects the matches the same way, even if an
+    // edit changes them far from it.
+    BlockHighlighter blocks;
+    blocks.setText(cascade);
+    QCOMPARE(blocks.highlights(), Highlights() << qMakePair(2, 2) << qMakePair(6, 8));
+    blocks.replace(13, 1, ".");
+    QCOMPARE(blocks.highlights(), Highlights() << qMakePair(0, 9));
+
+    // So does the reader, over several chunks.
+    QString lines;
+    for (int i = 0; i < 5000; ++i)
+        lines += cascade + '\n';
+    QByteArray data = lines.toUtf8();
+    QBuffer buffer(&data);
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+    HighlightReader reader(&buffer, 64);
+    Highlights read;
+    qint64 start;
+    QString fragment;
+    while (reader.readNext(&start, &fragment, 0))
+        read << qMakePair(int(start), fragment.length());
+    QCOMPARE(read.size(), 2 * 5000);
+    QCOMPARE(read, Action::findHighlights(lines));
+}
+
+void TestReload::missingDirectory()
+{
+    const QString text("dodo zork");
+    writeRules("dodo\\w*");
+    QTRY_COMPARE(Action::findHighlights(text), Highlights() << qMakePair(0, 4));
+
+    // The configuration directory is removed, and then created again.
+    QVERIFY(QDir(dir.path()).removeRecursively());
+    QTRY_COMPARE(Action::findHighlights(text), Highlights());
+    QVERIFY(QDir().mkpath(dir.path()));
+    writeRules("dodo\\w*", "zork\\w*");
+    QTRY_COMPARE(Action::findHighlights(text),
+                 Highlights() << qMakePair(0, 4) << qMakePair(5, 4));
+}
+
+QTEST_MAIN(TestReload)
+#include "test-reload.moc"
@@ -0,0 +1,253 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+// Runs the test cases of data/gen-regexps against the scanners generated
+// from the same regexps, and checks that the scanners find the same matches
+// as the regexps.
+
+#include "highlight.h"
+#include "scanners.h"
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QRegularExpression>
+#include <QTest>
+#include <QDebug>
+
+using namespace ContentAction::Internal;
+
+namespace {
+
+struct RegexpTest
+{
+    const char *action;
+    const char *regexp;
+    const char *spec;
+    char delimiter;
+};
+
+const RegexpTest RegexpTests[] = {
+#include "regexptests.inc"
+};
+
+// Pieces of text which make matches likely
+const char *const Pieces[] = {
+    "a", "b", "c", "p", "w", "x", " ", " ", "\n", ".", ",", "@", "1", "5",
+    "0", "-", "(", ")", "+", "#", "*", "/", ":", "?", "&", "'", "~", "%",
+    "ftp://", "http://", "www.", "feed:", "sip:", "tel:", "callto:", "sms:",
+    "mailto:", "example.com", "user@host.org", "555-1234", "\xc3\xa9",
+    "\xf0\x9f\x98\x80"
+};
+
+QString randomText(int pieces)
+{
+    const int count = sizeof(Pieces) / sizeof(*Pieces);
+    QString text;
+    for (int i = 0; i < pieces; ++i)
+        text += QString::fromUtf8(Pieces[qrand() % count]);
+    return text;
+}
+
+} // end anon namespace
+
+class TestScanners : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void regexpTests_data();
+    void regexpTests();
+    void equivalence();
+    void highlightScanner();
+    void utf8();
+    void longPartialMatches();
+};
+
+void TestScanners::initTestCase()
+{
+    qsrand(41);
+    // All the built-in categories have scanners.
+    QCOMPARE(generatedScanners().size(), 6);
+    QVERIFY(!generatedScanner("(a)\\1"));
+}
+
+void TestScanners::regexpTests_data()
+{
+    QTest::addColumn<QString>("regexp");
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<QStringList>("expected");
+
+    const int count = sizeof(RegexpTests) / sizeof(*RegexpTests);
+    for (int i = 0; i < count; ++i) {
+        const RegexpTest& test = RegexpTests[i];
+        // the text with the expected matches between the delimiters
+        QStringList parts = QString::fromUtf8(test.spec).split(QChar(test.delimiter));
+        QStringList expected;
+        for (int j = 1; j < parts.size(); j += 2)
+            expected << parts[j];
+        QTest::newRow(QByteArray(test.action) + ' ' + test.spec)
+            << QString::fromUtf8(test.regexp) << parts.join(QString()) << expected;
+    }
+}
+
+void TestScanners::regexpTests()
+{
+    QFETCH(QString, regexp);
+    QFETCH(QString, text);
+    QFETCH(QStringList, expected);
+
+    const GeneratedScanner *scanner = generatedScanner(regexp);
+    QVERIFY(scanner);
+    QStringList result;
+    for (int pos = 0; pos <= text.length(); ++pos) {
+        int end = scanner->match(text.utf16(), text.length(), pos);
+        if (end != -1) {
+            result << text.mid(pos, end - pos);
+            if (end > pos)
+                pos = end - 1;
+        }
+    }
+    QCOMPARE(result, expected);
+}
+
+void TestScanners::equivalence()
+{
+    int matches = 0;
+    Q_FOREACH (const GeneratedScanner *scanner, generatedScanners()) {
+        QRegularExpression re(QString::fromUtf8(scanner->pattern));
+        QVERIFY(re.isValid());
+        for (int round = 0; round < 300; ++round) {
+            QString text = randomText(qrand() % 40);
+            for (int pos = 0; pos <= text.length(); ++pos) {
+                if (pos > 0 && pos < text.length() && text.at(pos).isLowSurrogate())
+                    continue;
+                QRegularExpressionMatch match =
+                    re.match(text, pos, QRegularExpression::NormalMatch,
+                             QRegularExpression::AnchoredMatchOption);
+                int expected = match.hasMatch() ? match.capturedEnd() : -1;
+                int end = scanner->match(text.utf16(), text.length(), pos);
+                if (end != expected)
+                    qDebug() << scanner->name << text << pos;
+                QCOMPARE(end, expected);
+                if (end != -1)
+                    ++matches;
+            }
+        }
+    }
+    QVERIFY(matches > 1000);
+}
+
+void TestScanners::highlightScanner()
+{
+    // A scanner of all the categories finds the same matches with the
+    // generated scanners as with the master regexp.
+    HighlightScanner generated;
+    QStringList patterns;
+    QString re("(?:");
+    int group = 1;
+    Q_FOREACH (const GeneratedScanner *scanner, generatedScanners()) {
+        const QString pattern = QString::fromUtf8(scanner->pattern);
+        if (group > 1)
+            re += '|';
+        re += '(' + pattern + ')';
+        generated.categories << scanner->name;
+        generated.mimeTypes << QStringList();
+        generated.groups << group;
+        patterns << pattern;
+        group += 1 + QRegularExpression(pattern).captureCount();
+    }
+    re += ")";
+    generated.master = QRegularExpression(re);
+    HighlightScanner regexp = generated;
+    generated.backends = createBackends(patterns);
+    QCOMPARE(generated.backends.size(), 1);
+    QCOMPARE(generated.backends.first()->engine(), ContentAction::GeneratedEngine);
+
+    for (int round = 0; round < 1000; ++round) {
+        QString text = randomText(qrand() % 60);
+        int pos = 0;
+        for (;;) {
+            int start, length, expectedStart, expectedLength;
+            int expected = regexp.next(text, pos, &expectedStart, &expectedLength);
+            int found = generated.next(text, pos, &start, &length);
+            QCOMPARE(found, expected);
+            if (found == -1)
+                break;
+            QCOMPARE(start, expectedStart);
+            QCOMPARE(length, expectedLength);
+            pos = start + qMax(length, 1);
+        }
+    }
+}
+
+void TestScanners::utf8()
+{
+    // The scanners find the same matches in UTF-8 as in UTF-16.
+    QList<int> categories;
+    for (int i = 0; i < generatedScanners().size(); ++i)
+        categories << i;
+    GeneratedBackend backend(categories, generatedScanners());
+    for (int round = 0; round < 1000; ++round) {
+        QString text = randomText(qrand() % 60);
+        QByteArray bytes = text.toUtf8();
+        const uchar *data = reinterpret_cast<const uchar *>(bytes.constData());
+        int pos = 0, bytePos = 0;
+        for (;;) {
+            int start, length, byteStart, byteLength;
+            int expected = backend.next(text, pos, &start, &length);
+            int found = backend.next(data, bytes.length(), bytePos, &byteStart, &byteLength);
+            QCOMPARE(found, expected);
+            if (found == -1)
+                break;
+            QCOMPARE(byteStart, text.left(start).toUtf8().length());
+            QCOMPARE(QString::fromUtf8(bytes.mid(byteStart, byteLength)),
+                     text.mid(start, length));
+            pos = start + qMax(length, 1);
+            bytePos = byteStart + qMax(byteLength, 1);
+        }
+    }
+}
+
+void TestScanners::longPartialMatches()
+{
+    // Texts in which a match could start at every position but goes on to
+    // the end before it fails are searched in one pass.  Trying the
+    // scanners at each position in turn would take minutes for these.
+    const int length = 200000;
+    QList<int> categories;
+    for (int i = 0; i < generatedScanners().size(); ++i)
+        categories << i;
+    GeneratedBackend backend(categories, generatedScanners());
+    QElapsedTimer timer;
+    timer.start();
+    int start, matchLength;
+    QCOMPARE(backend.next(QString(length, 'a'), 0, &start, &matchLength), -1);
+    QCOMPARE(backend.next(QString("a.").repeated(length / 2), 0, &start, &matchLength), -1);
+    // a phone number is at most 20 digits long
+    int category = backend.next(QString(length, '1'), 0, &start, &matchLength);
+    QVERIFY(category != -1);
+    QCOMPARE(QString(generatedScanners()[category]->name), QString("phone-number"));
+    QCOMPARE(start, length - 20);
+    QCOMPARE(matchLength, 20);
+    QVERIFY2(timer.elapsed() < 2000, QByteArray::number(timer.elapsed()));
+}
+
+QTEST_MAIN(TestScanners)
+#include "test-scanners.moc"
@@ -0,0 +1,73 @@
+#!/usr/bin/python3
+##
+## Copyright (C) 2026 Jolla Ltd.
+##
+## This library is free software; you can redistribute it and/or
+## modify it under the terms of the GNU Lesser General Public License
+## version 2.1 as published by the Free Software Foundation.
+##
+## This library is distributed in the hope that it will be useful, but
+## WITHOUT ANY WARRANTY; without even the implied warranty of
+## MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+## Lesser General Public License for more details.
+##
+## You should have received a copy of the GNU Lesser General Public
+## License along with this library; if not, write to the Free Software
+## Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+## 02110-1301 USA
+
+import sys
+import os
+# Otherwise env.py won't be found when running tests inside a VPATH build dir
+sys.path.insert(0, os.getcwd())
+
+try: import env
+except: pass
+
+import unittest
+from subprocess import getstatusoutput
+from cltool import CLTool
+from tempfile import mkdtemp
+
+class ServiceCache(unittest.TestCase):
+    def setUp(self):
+        self.cachedir = mkdtemp()
+        self.cachefile = self.cachedir + "/servicefw.list"
+        os.environ["CONTENTACTION_SERVICE_CACHE"] = self.cachefile
+        # start a fake gallery service
+        self.gallery = CLTool("gallery.py")
+        self.assertTrue(self.gallery.expect("started"))
+
+    def tearDown(self):
+        self.gallery.kill()
+        if os.path.exists(self.cachefile):
+            os.remove(self.cachefile)
+        os.rmdir(self.cachedir)
+        del os.environ["CONTENTACTION_SERVICE_CACHE"]
+
+    def testMappingIsPersisted(self):
+        mapper = CLTool("servicemapper.py")
+        self.assertTrue(mapper.expect("started"))
+        (status, output) = getstatusoutput("lca-tool --triggerdesktop galleryserviceinterface.desktop first")
+        self.assertTrue(status == 0)
+        self.assertTrue(self.gallery.expect("showImage ; first"))
+        mapper.kill()
+
+        f = open(self.cachefile)
+        content = f.read()
+        f.close()
+        self.assertTrue(content.find("com.nokia.galleryserviceinterface=just.a.gallery") != -1)
+
+        # The mapper is gone, but the implementor is still known from the
+        # previous run.
+        (status, output) = getstatusoutput("lca-tool --triggerdesktop galleryserviceinterface.desktop second")
+        self.assertTrue(status == 0)
+        self.assertTrue(self.gallery.expect("showImage ; second"))
+
+def runTests():
+    suite = unittest.TestLoader().loadTestsFromTestCase(ServiceCache)
+    result = unittest.TextTestRunner(verbosity=2).run(suite)
+    return len(result.errors + result.failures)
+
+if __name__ == "__main__":
+    sys.exit(runTests())
@@ -1,6 +1,7 @@
 include(testcase.pri)
 TARGET = test-action
 SOURCES = test-action.cpp
+QT += dbus
 
 
 
@@ -0,0 +1,3 @@
+include(testcase.pri)
+TARGET = test-automaton
+SOURCES = test-automaton.cpp
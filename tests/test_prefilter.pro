@@ -0,0 +1,3 @@
+include(testcase.pri)
+TARGET = test-prefilter
+SOURCES = test-prefilter.cpp
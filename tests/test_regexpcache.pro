@@ -0,0 +1,3 @@
+include(testcase.pri)
+TARGET = test-regexpcache
+SOURCES = test-regexpcache.cpp
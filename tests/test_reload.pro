@@ -0,0 +1,3 @@
+include(testcase.pri)
+TARGET = test-reload
+SOURCES = test-reload.cpp
@@ -0,0 +1,16 @@
+include(testcase.pri)
+TARGET = test-scanners
+SOURCES = test-scanners.cpp
+
+# The test cases of the regexps the scanners are generated from
+REGEXP_GENERATOR = ../data/gen-regexps
+
+regexptests.input = REGEXP_GENERATOR
+regexptests.output = regexptests.inc
+regexptests.commands = ${QMAKE_FILE_IN} cpp > ${QMAKE_FILE_OUT}
+regexptests.depends = $$PWD/../data/regextest2.py
+regexptests.name = regexptests
+regexptests.CONFIG += no_link target_predeps
+QMAKE_EXTRA_COMPILERS += regexptests
+
+INCLUDEPATH += $$OUT_PWD
@@ -27,6 +27,7 @@ testscripts.files = \
     test-desktop-launching.py \
     test-l10n.sh \
     test-fixed-params.py \
+    test-service-cache.py \
     test-schemes.sh \
     test-special-chars.py \
     test-regexps.py \
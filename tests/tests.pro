@@ -7,4 +7,9 @@ SUBDIRS = \
     test_info.pro \
     test_action.pro \
     test_findhighlights.pro \
+    test_prefilter.pro \
+    test_regexpcache.pro \
+    test_scanners.pro \
+    test_automaton.pro \
+    test_reload.pro \
     test_mimedefaults.pro
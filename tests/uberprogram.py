@@ -14,6 +14,18 @@ class Uberprogram(dbus.service.FallbackObject):
         print('launch:', uris)
         stdout.flush()
 
+    @dbus.service.method(dbus_interface='org.freedesktop.Application',
+                         in_signature='a{sv}')
+    def Activate(self, platform_data):
+        print('Activate')
+        stdout.flush()
+
+    @dbus.service.method(dbus_interface='org.freedesktop.Application',
+                         in_signature='asa{sv}')
+    def Open(self, uris, platform_data):
+        print('Open:', ' '.join(uris))
+        stdout.flush()
+
     @dbus.service.method(dbus_interface="uber.program")
     def mime_open(self, *args):
         print('mime_open: ', args)
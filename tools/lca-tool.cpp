@@ -26,6 +26,7 @@
 #include <QTextStream>
 #include <QCoreApplication>
 #include <QDebug>
+#include <QFile>
 #include <QFileInfo>
 
 #if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
@@ -65,6 +66,7 @@ static const char help[] = \
 "  --setmimedefault MIME ACTION    set ACTION as default for the given mimetype\n"
 "  --resetmimedefault MIME         remove the user-defined default from the given mimetype\n"
 "  --highlight                     will read text from stdin and find actions for items in it\n"
+"  --highlightengines              print the regexp engine of each highlighter category\n"
 "  --triggerdesktop DESKTOPFILE PARAMS   will launch the application defined by DESKTOPFILE with the given PARAMS\n"
 
 "\n"
@@ -107,6 +109,7 @@ enum ActionToDo {
     SetMimeDefault,
     ResetMimeDefault,
     Highlight,
+    PrintHighlightEngines,
     TriggerDesktop
 };
 
@@ -139,56 +142,84 @@ QDebug operator<<(QDebug dbg, const QList<Match>& ms)
     return dbg;
 }
 
+/*
+ * Prints the match results for the standard input as it is being read, so
+ * that arbitrarily long input can be highlighted.
+ */
+void doStreamHighlight()
+{
+    QTextStream out(stdout);
+    QFile input;
+    input.open(stdin, QIODevice::ReadOnly);
+    HighlightReader reader(&input);
+
+    qint64 start;
+    QString highlight;
+    while (reader.readNext(&start, &highlight, 0)) {
+        QStringList actions;
+        Q_FOREACH (const Action& a, reader.actions())
+            actions << a.name();
+        out << QString("%1 %2 '%3' %4\n").arg(QString::number(start),
+                                              QString::number(start + highlight.length()),
+                                              highlight,
+                                              actions.join(" "));
+    }
+}
+
 /*
  * Reads text from the standard input, highlight rules from the usual place
  * (ie. xml files in $CONTENTACTION_ACTIONS) and then prints match results on
  * the standard output.  If the terminal is a tty, the results are printed on
  * stderr, and on stdout a beautifully colored version of the text is shown.
+ * Otherwise the input is not read into memory as a whole.
  */
 void doHighlight()
 {
-    QTextStream out(isatty(1) ? stderr : stdout);
-    QTextStream textout(isatty(1) > 0 ? stdout : fopen("/dev/null", "w"));
+    if (!isatty(1)) {
+        doStreamHighlight();
+        return;
+    }
+    QTextStream out(stderr);
+    QTextStream textout(stdout);
     QTextStream in(stdin);
     QString text = in.readAll();
 
-    QList<QPair<int, int> > highlights = Action::findHighlights(text);
-    QList<QPair<int, int> >::const_iterator it = highlights.begin();
+    // One pass finds the fragments and the actions for them.
+    QList<HighlightMatch> highlights = Action::highlight(text, HighlightOptions());
+    QList<HighlightMatch>::const_iterator it = highlights.begin();
 
     while (it != highlights.end()) {
-        QString highlight = text.mid(it->first, it->second);
+        QString highlight = text.mid(it->start, it->end - it->start);
         QStringList actions;
-        Q_FOREACH (const Action& a, Action::actionsForString(highlight))
+        Q_FOREACH (const Action& a, it->applicableActions())
             actions << a.name();
-        out << QString("%1 %2 '%3' %4\n").arg(QString::number(it->first),
-                                              QString::number(it->first + it->second),
+        out << QString("%1 %2 '%3' %4\n").arg(QString::number(it->start),
+                                              QString::number(it->end),
                                               highlight,
                                               actions.join(" "));
         ++it;
     }
     QString hltext(text);
-    if (isatty(1)) {
-        QString color[] = {
-            "\e[1;37;41m",
-            "\e[1;37;42m",
-            "\e[1;37;43m",
-            "\e[1;37;44m",
-            "\e[1;37;45m",
-            "\e[1;37;46m",
-        };
-        int i = 0;
-        int d = 0;
-        it = highlights.begin();
-        while (it != highlights.end()) {
-            hltext.insert(d + it->first, color[i]);
-            d += color[i].length();
-            i = (i + 1) % (sizeof(color) / sizeof(color[0]));
-            hltext.insert(d + it->second, "\e[0m");
-            d += 4;
-            ++it;
-        }
-        textout << hltext;
+    QString color[] = {
+        "\e[1;37;41m",
+        "\e[1;37;42m",
+        "\e[1;37;43m",
+        "\e[1;37;44m",
+        "\e[1;37;45m",
+        "\e[1;37;46m",
+    };
+    int i = 0;
+    int d = 0;
+    it = highlights.begin();
+    while (it != highlights.end()) {
+        hltext.insert(d + it->start, color[i]);
+        d += color[i].length();
+        i = (i + 1) % (sizeof(color) / sizeof(color[0]));
+        hltext.insert(d + it->end, "\e[0m");
+        d += 4;
+        ++it;
     }
+    textout << hltext;
 }
 
 int main(int argc, char **argv)
@@ -269,6 +300,9 @@ int main(int argc, char **argv)
         else if (arg == "--highlight") {
             todo = Highlight;
         }
+        else if (arg == "--highlightengines") {
+            todo = PrintHighlightEngines;
+        }
         else if (arg == "--triggerdesktop") {
             todo = TriggerDesktop;
             NEEDARG("a DESKTOPFILE must be given when using --triggerdesktop");
@@ -320,6 +354,15 @@ int main(int argc, char **argv)
     case Highlight:
         doHighlight();
         return 0;
+    case PrintHighlightEngines:
+    {
+        const char *names[] = { "generated", "automaton", "backtracking" };
+        QMap<QString, HighlightEngine> engines = highlightEngines();
+        for (QMap<QString, HighlightEngine>::const_iterator it = engines.constBegin();
+             it != engines.constEnd(); ++it)
+            out << it.key() << " " << names[it.value()] << endl;
+        return 0;
+    }
     case TriggerDesktop:
     {
         Action a = Action::launcherAction(actionName, args);